@@ -0,0 +1,211 @@
+//
+//  compact.c
+//  LinkedListApp
+//
+//  Compact linked list - growing the node array, linking by index and reusing deleted nodes.
+//
+
+#include <stdio.h>
+#include "list.h"
+#include "compact.h"
+
+#ifdef USE_LOCK
+#define COMPACT_LOCK(cont) llist_spin_lock(&(cont)->locked)
+#define COMPACT_UNLOCK(cont) llist_spin_unlock(&(cont)->locked)
+#else
+#define COMPACT_LOCK(cont) ({})
+#define COMPACT_UNLOCK(cont) ({})
+#endif
+
+/* llist_compact_grow resizes the node and size arrays to hold n_nodes nodes.  Links are indices, so nothing needs
+ fixing up when realloc moves the arrays.  The caller must hold the container lock.  Returns -1 on failure */
+static int llist_compact_grow(struct llist_compact_container *cont, uint32_t n_nodes) {
+    struct llist_compact_node *nodes = realloc(cont->nodes, (size_t)n_nodes * sizeof(struct llist_compact_node));
+    if(!nodes)
+        return -1;
+    cont->nodes = nodes;
+    uint32_t *sizes = realloc(cont->sizes, (size_t)n_nodes * sizeof(uint32_t));
+    if(!sizes)
+        return -1;
+    cont->sizes = sizes;
+    cont->n_nodes = n_nodes;
+    return 0;
+}
+
+/* llist_compact_live checks index refers to an entry in the list rather than a free or never used node.  A deleted
+ node has no previous entry but isn't the head.  The caller must hold the container lock */
+static bool llist_compact_live(struct llist_compact_container *cont, uint32_t index) {
+    if(index >= cont->used)
+        return false;
+    return cont->nodes[index].prev != LLIST_COMPACT_NIL || cont->head == index;
+}
+
+/* compact_container_new creates an empty compact list with room for n_entries entries before it has to grow */
+struct llist_compact_container *compact_container_new(size_t n_entries) {
+    if(n_entries > LLIST_COMPACT_MAX) {
+        printf("Too many entries for a compact list\n");
+        return NULL;
+    }
+    struct llist_compact_container *new = calloc(1, sizeof(struct llist_compact_container));
+    if(!new)
+        return NULL;
+    atomic_init(&new->locked, LLIST_LOCK_FREE);
+    new->free_list = new->head = new->tail = LLIST_COMPACT_NIL;
+    if(n_entries && llist_compact_grow(new, (uint32_t)n_entries) < 0) {
+        compact_container_free(new, false);
+        return NULL;
+    }
+    return new;
+}
+
+/* compact_container_free frees a compact list, freeing the data in every entry too if free_data is true */
+void compact_container_free(struct llist_compact_container *cont, bool free_data) {
+    if(!cont)
+        return;
+    if(free_data) {
+        for(uint32_t i = cont->head; i != LLIST_COMPACT_NIL; i = cont->nodes[i].next)
+            free(cont->nodes[i].data);
+    }
+    free(cont->nodes);
+    free(cont->sizes);
+    free(cont);
+}
+
+/* llist_compact_node_new takes a node off the free list, or the next never used node, growing the arrays if they
+ are full.  The caller must hold the container lock.  Returns the node index, or LLIST_COMPACT_NIL on failure */
+static uint32_t llist_compact_node_new(struct llist_compact_container *cont, void *data, size_t d_size) {
+    uint32_t index = cont->free_list;
+    if(d_size > UINT32_MAX) {
+        printf("Data too large for a compact list entry\n");
+        return LLIST_COMPACT_NIL;
+    }
+    if(index != LLIST_COMPACT_NIL) {
+        cont->free_list = cont->nodes[index].next;
+    } else {
+        if(cont->used == cont->n_nodes) {
+            if(cont->n_nodes == LLIST_COMPACT_MAX) {
+                printf("Compact list is full\n");
+                return LLIST_COMPACT_NIL;
+            }
+            uint64_t n_nodes = cont->n_nodes ? (uint64_t)cont->n_nodes * 2 : LLIST_COMPACT_MIN;
+            if(n_nodes > LLIST_COMPACT_MAX)
+                n_nodes = LLIST_COMPACT_MAX;
+            if(llist_compact_grow(cont, (uint32_t)n_nodes) < 0) {
+                printf("Failed growing compact list\n");
+                return LLIST_COMPACT_NIL;
+            }
+        }
+        index = cont->used++;
+    }
+    cont->nodes[index].data = data;
+    cont->sizes[index] = (uint32_t)d_size;
+    return index;
+}
+
+/* llist_compact_link links node index in between prev and next, either of which may be LLIST_COMPACT_NIL.
+ The caller must hold the container lock */
+static void llist_compact_link(struct llist_compact_container *cont, uint32_t index, uint32_t prev, uint32_t next) {
+    cont->nodes[index].prev = prev;
+    cont->nodes[index].next = next;
+    if(prev != LLIST_COMPACT_NIL)
+        cont->nodes[prev].next = index;
+    else
+        cont->head = index;
+    if(next != LLIST_COMPACT_NIL)
+        cont->nodes[next].prev = index;
+    else
+        cont->tail = index;
+    cont->list_entries++;
+}
+
+/* llist_compact_add_head adds a new head entry holding data.  Returns the index of the new entry, or
+ LLIST_COMPACT_NIL on failure */
+uint32_t llist_compact_add_head(struct llist_compact_container *cont, void *data, size_t d_size) {
+    if(!cont)
+        return LLIST_COMPACT_NIL;
+    COMPACT_LOCK(cont);
+    uint32_t index = llist_compact_node_new(cont, data, d_size);
+    if(index != LLIST_COMPACT_NIL)
+        llist_compact_link(cont, index, LLIST_COMPACT_NIL, cont->head);
+    COMPACT_UNLOCK(cont);
+    return index;
+}
+
+/* llist_compact_add_tail adds a new tail entry holding data.  Returns the index of the new entry, or
+ LLIST_COMPACT_NIL on failure */
+uint32_t llist_compact_add_tail(struct llist_compact_container *cont, void *data, size_t d_size) {
+    if(!cont)
+        return LLIST_COMPACT_NIL;
+    COMPACT_LOCK(cont);
+    uint32_t index = llist_compact_node_new(cont, data, d_size);
+    if(index != LLIST_COMPACT_NIL)
+        llist_compact_link(cont, index, cont->tail, LLIST_COMPACT_NIL);
+    COMPACT_UNLOCK(cont);
+    return index;
+}
+
+/* llist_compact_insert_after adds a new entry holding data straight after the entry at index.  Returns the index of
+ the new entry, or LLIST_COMPACT_NIL on failure */
+uint32_t llist_compact_insert_after(struct llist_compact_container *cont, uint32_t index, void *data, size_t d_size) {
+    if(!cont)
+        return LLIST_COMPACT_NIL;
+    COMPACT_LOCK(cont);
+    if(!llist_compact_live(cont, index)) {
+        printf("No compact list entry at index %u\n", index);
+        COMPACT_UNLOCK(cont);
+        return LLIST_COMPACT_NIL;
+    }
+    uint32_t new = llist_compact_node_new(cont, data, d_size);
+    if(new != LLIST_COMPACT_NIL)
+        llist_compact_link(cont, new, index, cont->nodes[index].next);
+    COMPACT_UNLOCK(cont);
+    return new;
+}
+
+/* llist_compact_delete deletes the entry at index, freeing its data too if free_data is true.  The node goes
+ straight onto the free list, so the index may be handed out again by the next add */
+int llist_compact_delete(struct llist_compact_container *cont, uint32_t index, bool free_data) {
+    if(!cont)
+        return -1;
+    COMPACT_LOCK(cont);
+    if(!llist_compact_live(cont, index)) {
+        printf("No compact list entry at index %u\n", index);
+        COMPACT_UNLOCK(cont);
+        return -1;
+    }
+    struct llist_compact_node *node = &cont->nodes[index];
+    if(node->prev != LLIST_COMPACT_NIL)
+        cont->nodes[node->prev].next = node->next;
+    else
+        cont->head = node->next;
+    if(node->next != LLIST_COMPACT_NIL)
+        cont->nodes[node->next].prev = node->prev;
+    else
+        cont->tail = node->prev;
+    if(free_data)
+        free(node->data);
+    node->data = NULL;
+    node->prev = LLIST_COMPACT_NIL;
+    node->next = cont->free_list;
+    cont->free_list = index;
+    cont->list_entries--;
+    COMPACT_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_compact_foreach calls fn with the data of every entry from head to tail, stopping early if fn returns
+ false.  fn must not add or delete entries.  Returns the number of entries visited, or -1 */
+long llist_compact_foreach(struct llist_compact_container *cont, bool (*fn)(void *data, size_t d_size, void *arg),
+                           void *arg) {
+    long visited = 0;
+    if(!cont || !fn)
+        return -1;
+    COMPACT_LOCK(cont);
+    for(uint32_t i = cont->head; i != LLIST_COMPACT_NIL; i = cont->nodes[i].next) {
+        visited++;
+        if(!fn(cont->nodes[i].data, cont->sizes[i], arg))
+            break;
+    }
+    COMPACT_UNLOCK(cont);
+    return visited;
+}
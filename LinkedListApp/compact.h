@@ -0,0 +1,64 @@
+//
+//  compact.h
+//  LinkedListApp
+//
+//  Compact linked list - every node lives in one growable array and nodes are linked by 32 bit indices into that
+//  array rather than by pointers.  A node takes 16 bytes plus 4 for its data size against the 40 of a struct llist,
+//  the array can be moved or grown without fixing up a single link, and deleted nodes are reused through a free
+//  list threaded through the same indices.  A list can hold up to LLIST_COMPACT_MAX nodes and payloads up to 4GB each.
+//
+
+#ifndef compact_h
+#define compact_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#define LLIST_COMPACT_NIL UINT32_MAX // Index standing in for a NULL link
+#define LLIST_COMPACT_MAX (UINT32_MAX - 1) // Most nodes a compact list can hold
+#define LLIST_COMPACT_MIN 64 // Nodes allocated the first time a compact list grows
+
+/* struct llist_compact_node is an entry in a compact list */
+struct llist_compact_node {
+    uint32_t next; // Index of the next entry, LLIST_COMPACT_NIL at the tail - next free node once deleted
+    uint32_t prev; // Index of the previous entry, LLIST_COMPACT_NIL at the head and once deleted
+    void *data; // Data in linked list
+};
+
+/* struct llist_compact_container contains a compact list.  Because the node array can move when the list grows,
+ node pointers from llist_compact_node are only good until the next add - keep indices instead */
+struct llist_compact_container {
+    struct llist_compact_node *nodes; // Node array, n_nodes long
+    uint32_t *sizes; // Data size of each node, kept apart so scans that only follow links and data don't load them
+    uint32_t n_nodes; // Nodes allocated
+    uint32_t used; // Nodes ever handed out - everything past this has never been used
+    uint32_t free_list; // First deleted node waiting to be reused, linked through next
+    uint32_t head; // First entry, LLIST_COMPACT_NIL if the list is empty
+    uint32_t tail; // Last entry
+    size_t list_entries;
+    _Atomic(uint32_t) locked; // Spin lock, taken around every operation if USE_LOCK is defined
+};
+
+struct llist_compact_container *compact_container_new(size_t n_entries);
+void compact_container_free(struct llist_compact_container *cont, bool free_data);
+uint32_t llist_compact_add_head(struct llist_compact_container *cont, void *data, size_t d_size);
+uint32_t llist_compact_add_tail(struct llist_compact_container *cont, void *data, size_t d_size);
+uint32_t llist_compact_insert_after(struct llist_compact_container *cont, uint32_t index, void *data, size_t d_size);
+int llist_compact_delete(struct llist_compact_container *cont, uint32_t index, bool free_data);
+long llist_compact_foreach(struct llist_compact_container *cont, bool (*fn)(void *data, size_t d_size, void *arg),
+                           void *arg);
+
+/* llist_compact_node returns the node at index.  The pointer is only good until the list next grows */
+static inline struct llist_compact_node *llist_compact_node(struct llist_compact_container *cont, uint32_t index) {
+    return &cont->nodes[index];
+}
+
+/* llist_compact_data_size returns the size of the data held by the node at index */
+static inline size_t llist_compact_data_size(struct llist_compact_container *cont, uint32_t index) {
+    return cont->sizes[index];
+}
+
+#endif /* compact_h */
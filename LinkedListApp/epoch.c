@@ -0,0 +1,128 @@
+//
+//  epoch.c
+//  LinkedListApp
+//
+//  Epoch based reclamation - thread registration, advancing the global epoch and freeing retired objects.
+//
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include "epoch.h"
+
+_Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) llist_epoch_global; // Global epoch, only ever moves forward
+_Thread_local struct llist_epoch_thread *llist_epoch_self; // This thread's record, NULL until first registered
+static _Atomic(struct llist_epoch_thread *) llist_epoch_threads; // Every thread record ever allocated
+static pthread_key_t llist_epoch_key; // Runs llist_epoch_thread_exit when a registered thread exits
+static pthread_once_t llist_epoch_key_once = PTHREAD_ONCE_INIT;
+
+/* llist_epoch_thread_exit hands a thread's record back when the thread exits, leaving anything it retired that
+ couldn't be freed yet for whichever thread picks the record up next */
+static void llist_epoch_thread_exit(void *ptr) {
+    struct llist_epoch_thread *self = ptr;
+    self->nesting = 0;
+    atomic_store_explicit(&self->state, 0, memory_order_release);
+    llist_epoch_collect();
+    llist_epoch_self = NULL;
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+}
+
+/* llist_epoch_key_create creates the key used to catch thread exits */
+static void llist_epoch_key_create(void) {
+    pthread_key_create(&llist_epoch_key, llist_epoch_thread_exit);
+}
+
+/* llist_epoch_register sets up the epoch record for the calling thread, reusing the record of a thread that has
+ exited if there is one.  Returns the record, or NULL on failure */
+struct llist_epoch_thread *llist_epoch_register(void) {
+    struct llist_epoch_thread *self;
+    pthread_once(&llist_epoch_key_once, llist_epoch_key_create);
+    for(self = atomic_load_explicit(&llist_epoch_threads, memory_order_acquire); self; self = self->next) {
+        bool in_use = false;
+        if(!atomic_load_explicit(&self->in_use, memory_order_relaxed) &&
+           atomic_compare_exchange_strong_explicit(&self->in_use, &in_use, true, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+    if(!self) {
+        self = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_epoch_thread));
+        if(!self) {
+            printf("Failed allocating epoch thread record\n");
+            return NULL;
+        }
+        memset(self, 0, sizeof(struct llist_epoch_thread));
+        atomic_init(&self->state, 0);
+        atomic_init(&self->in_use, true);
+        self->next = atomic_load_explicit(&llist_epoch_threads, memory_order_relaxed);
+        while(!atomic_compare_exchange_weak_explicit(&llist_epoch_threads, &self->next, self,
+                                                     memory_order_release, memory_order_relaxed))
+            ;
+    }
+    pthread_setspecific(llist_epoch_key, self);
+    llist_epoch_self = self;
+    return self;
+}
+
+/* llist_epoch_try_advance moves the global epoch on by one if every thread in a critical section has already seen
+ the current epoch.  Returns true if the epoch was advanced, by us or by another thread */
+bool llist_epoch_try_advance(void) {
+    uint64_t epoch = atomic_load(&llist_epoch_global);
+    atomic_thread_fence(memory_order_seq_cst);
+    for(struct llist_epoch_thread *thread = atomic_load_explicit(&llist_epoch_threads, memory_order_acquire);
+        thread; thread = thread->next) {
+        // Acquire pairs with the release in llist_epoch_exit, so anything a thread did in its last critical
+        // section happens before whatever we go on to free
+        uint64_t state = atomic_load_explicit(&thread->state, memory_order_acquire);
+        if((state & LLIST_EPOCH_ACTIVE) && (state >> 1) != epoch)
+            return false;
+    }
+    // If this fails another thread has already moved the epoch on
+    atomic_compare_exchange_strong(&llist_epoch_global, &epoch, epoch + 1);
+    return true;
+}
+
+/* llist_epoch_retire hands ptr over to be freed with free_fn once no thread can still be using it.  The caller
+ must already have made ptr unreachable.  This never frees anything itself so it is safe to call under a lock -
+ leaving a critical section or llist_epoch_poll does the freeing.  Returns -1 if ptr couldn't be queued, in which
+ case it is leaked rather than freed early */
+int llist_epoch_retire(void *ptr, void (*free_fn)(void *ptr)) {
+    struct llist_epoch_thread *self = llist_epoch_self;
+    if(!ptr)
+        return 0;
+    if(!self && !(self = llist_epoch_register()))
+        return -1;
+    if(self->n_retired == self->max_retired) {
+        size_t max_retired = self->max_retired ? self->max_retired * 2 : LLIST_EPOCH_COLLECT;
+        struct llist_epoch_retired *retired = realloc(self->retired, max_retired * sizeof(struct llist_epoch_retired));
+        if(!retired) {
+            printf("Failed growing epoch retire list, leaking %p\n", ptr);
+            return -1;
+        }
+        self->retired = retired;
+        self->max_retired = max_retired;
+    }
+    self->retired[self->n_retired].ptr = ptr;
+    self->retired[self->n_retired].free_fn = free_fn;
+    self->retired[self->n_retired].epoch = llist_epoch_stamp();
+    self->n_retired++;
+    return 0;
+}
+
+/* llist_epoch_collect tries to advance the global epoch, then frees everything this thread retired at least two
+ epochs ago - every thread that could have seen those objects has left its critical section since */
+void llist_epoch_collect(void) {
+    struct llist_epoch_thread *self = llist_epoch_self;
+    size_t done = 0;
+    if(!self || !self->n_retired)
+        return;
+    llist_epoch_try_advance();
+    uint64_t epoch = atomic_load(&llist_epoch_global);
+    // Objects are retired in epoch order, so we can stop at the first one that isn't safe yet
+    while(done < self->n_retired && self->retired[done].epoch + 2 <= epoch) {
+        self->retired[done].free_fn(self->retired[done].ptr);
+        done++;
+    }
+    if(done) {
+        memmove(self->retired, self->retired + done, (self->n_retired - done) * sizeof(struct llist_epoch_retired));
+        self->n_retired -= done;
+    }
+}
@@ -0,0 +1,101 @@
+//
+//  epoch.h
+//  LinkedListApp
+//
+//  Epoch based reclamation.  Readers that walk shared structures without a lock wrap the walk in
+//  llist_epoch_enter/llist_epoch_exit.  Anything unlinked while readers might still hold a pointer to it is handed
+//  to llist_epoch_retire instead of being freed, and is only freed once every thread that was inside a critical
+//  section when it was retired has left it - which we know has happened once the global epoch has moved on twice.
+//
+
+#ifndef epoch_h
+#define epoch_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#define LLIST_EPOCH_COLLECT 64 // Retired objects a thread holds before leaving a critical section tries to free them
+#define LLIST_EPOCH_ACTIVE ((uint64_t)1) // Low bit of a thread's epoch state, set while it is in a critical section
+
+/* struct llist_epoch_retired is an object waiting to be freed */
+struct llist_epoch_retired {
+    void *ptr;
+    void (*free_fn)(void *ptr); // Called with ptr once it is safe to free
+    uint64_t epoch; // Global epoch when ptr was retired - it is freed once the global epoch is two past this
+};
+
+/* struct llist_epoch_thread is the epoch state of one thread.  These are never freed - when a thread exits its
+ record is left for the next new thread to pick up, along with anything it retired that hadn't been freed yet */
+struct llist_epoch_thread {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) state; // Epoch shifted up one with LLIST_EPOCH_ACTIVE while in a critical section, 0 outside one
+    _Atomic(bool) in_use; // Cleared when the owning thread exits
+    unsigned int nesting; // Critical sections this thread has entered and not yet left
+    struct llist_epoch_retired *retired; // Objects retired by this thread, oldest first
+    size_t n_retired;
+    size_t max_retired; // Size of the retired array
+    struct llist_epoch_thread *next; // Next record in the list of every thread record
+};
+
+extern _Atomic(uint64_t) llist_epoch_global;
+extern _Thread_local struct llist_epoch_thread *llist_epoch_self;
+
+struct llist_epoch_thread *llist_epoch_register(void);
+bool llist_epoch_try_advance(void);
+int llist_epoch_retire(void *ptr, void (*free_fn)(void *ptr));
+void llist_epoch_collect(void);
+
+/* llist_epoch_current returns the global epoch */
+static inline uint64_t llist_epoch_current(void) {
+    return atomic_load(&llist_epoch_global);
+}
+
+/* llist_epoch_stamp returns the epoch to stamp an object with as it is retired, once the caller has unlinked it.
+ The retiring thread needn't be in a critical section, so the stores that unlinked the object could otherwise still
+ be sitting in its store buffer when the epoch is read - a reader entering the next epoch could then find the object
+ after all and still hold it when it is freed.  The fence pairs with the one in llist_epoch_enter - either the reader
+ sees the object unlinked, or we see at least the epoch the reader entered in */
+static inline uint64_t llist_epoch_stamp(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&llist_epoch_global, memory_order_relaxed);
+}
+
+/* llist_epoch_enter starts a critical section - nothing retired after this point is freed until the matching
+ llist_epoch_exit.  Critical sections nest, only the outermost one publishes the epoch.  Returns -1 if the thread
+ couldn't be registered, in which case the caller must not go on to call llist_epoch_exit */
+static inline int llist_epoch_enter(void) {
+    struct llist_epoch_thread *self = llist_epoch_self;
+    if(!self && !(self = llist_epoch_register()))
+        return -1;
+    if(self->nesting++ == 0) {
+        uint64_t epoch = atomic_load_explicit(&llist_epoch_global, memory_order_relaxed);
+        atomic_store_explicit(&self->state, (epoch << 1) | LLIST_EPOCH_ACTIVE, memory_order_relaxed);
+        // Pairs with the fence in llist_epoch_try_advance - either it sees us active, or we see everything
+        // unlinked before the epoch it is advancing from
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    return 0;
+}
+
+/* llist_epoch_exit ends a critical section started with llist_epoch_enter.  Leaving the outermost section frees
+ whatever this thread has retired that is now safe to free, once enough has built up to be worth the look */
+static inline void llist_epoch_exit(void) {
+    struct llist_epoch_thread *self = llist_epoch_self;
+    if(--self->nesting > 0)
+        return;
+    atomic_store_explicit(&self->state, 0, memory_order_release);
+    if(self->n_retired >= LLIST_EPOCH_COLLECT)
+        llist_epoch_collect();
+}
+
+/* llist_epoch_poll frees whatever this thread has retired that is now safe to free, once enough has built up to be
+ worth the look.  Callers that retire objects under a lock call this once they have let go of it */
+static inline void llist_epoch_poll(void) {
+    struct llist_epoch_thread *self = llist_epoch_self;
+    if(self && self->n_retired >= LLIST_EPOCH_COLLECT)
+        llist_epoch_collect();
+}
+
+#endif /* epoch_h */
@@ -0,0 +1,428 @@
+//
+//  hashmap.c
+//  LinkedListApp
+//
+//  Flat open addressing hash index used by the linked list containers.
+//
+
+#include <string.h>
+#include <stdio.h>
+#include "hashmap.h"
+#include "epoch.h"
+
+/* hash_map_tag returns the tag stored in the control byte of a full slot - the low 7 bits of the hash with the
+ top bit set to mark the slot full */
+static inline int8_t hash_map_tag(uint64_t hash) {
+    return (int8_t)(0x80 | (hash & 0x7F));
+}
+
+/* hash_map_first_group returns the group a probe for hash starts from, using bits that don't feed the tag */
+static inline size_t hash_map_first_group(struct llist_map_table *table, uint64_t hash) {
+    return (size_t)(hash >> 7) & (table->n_slots / HASHMAP_GROUP - 1);
+}
+
+/* hash_map_group_match returns a bitmask with a bit set for each control byte in the group equal to tag */
+static inline uint32_t hash_map_group_match(const int8_t *group, int8_t tag) {
+#if defined(__AVX2__)
+    __m256i ctrl = _mm256_loadu_si256((const __m256i *)group);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(tag)));
+#elif defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < HASHMAP_GROUP; i++)
+        mask |= (uint32_t)(group[i] == tag) << i;
+    return mask;
+#endif
+}
+
+/* hash_map_group_free returns a bitmask of the slots in the group that are empty or deleted - those are the
+ control bytes without the top bit set, so this is just the inverted sign bits of the group */
+static inline uint32_t hash_map_group_free(const int8_t *group) {
+#if defined(__AVX2__)
+    return ~(uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)group));
+#elif defined(__SSE2__)
+    return ~(uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group)) & 0xFFFF;
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < HASHMAP_GROUP; i++)
+        mask |= (uint32_t)!HASHMAP_CTRL_FULL(group[i]) << i;
+    return mask;
+#endif
+}
+
+/* hash_map_group_empty returns true if any slot in the group has never been used, which ends a probe */
+static inline bool hash_map_group_empty(const int8_t *group) {
+    return hash_map_group_match(group, HASHMAP_CTRL_EMPTY) != 0;
+}
+
+/* hash_map_alloc allocates a table of n_slots slots along with its control bytes in a single block.  An empty
+ control byte is zero, so calloc hands back an empty table without us touching every page of it up front -
+ which matters when a large index grows */
+static struct llist_map_table *hash_map_alloc(size_t n_slots) {
+    struct llist_map_table *table = calloc(1, sizeof(struct llist_map_table) + n_slots * (sizeof(struct llist_map_slot) + 1));
+    if(!table)
+        return NULL;
+    table->ctrl = (int8_t *)(table->slots + n_slots);
+    table->n_slots = n_slots;
+    return table;
+}
+
+/* hash_map_retire hands a table that lookups may still be probing over to epoch reclamation */
+static inline void hash_map_retire(struct llist_map_table *table) {
+    llist_epoch_retire(table, free);
+}
+
+/* hash_map_place puts an entry in the first free slot along its probe sequence.  The slot is filled in before its
+ control byte is published, so a lookup that sees the tag always finds the entry behind it.
+ The caller must ensure there is a free slot */
+static void hash_map_place(struct llist_map_table *table, void *entry, uint64_t hash) {
+    size_t g_mask = table->n_slots / HASHMAP_GROUP - 1;
+    size_t group = hash_map_first_group(table, hash);
+    for(size_t probe = 1;; probe++) {
+        uint32_t free_mask = hash_map_group_free(table->ctrl + group * HASHMAP_GROUP);
+        if(free_mask) {
+            size_t slot = group * HASHMAP_GROUP + __builtin_ctz(free_mask);
+            if(table->ctrl[slot] == HASHMAP_CTRL_DELETED)
+                table->deleted--;
+            __atomic_store_n(&table->slots[slot].entry, entry, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->slots[slot].hash, hash, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->ctrl[slot], hash_map_tag(hash), __ATOMIC_RELEASE);
+            table->used++;
+            return;
+        }
+        group = (group + probe) & g_mask;
+    }
+}
+
+/* hash_map_table_find returns the slot holding the first entry in a table with a matching hash that match accepts -
+ or if match is NULL, the slot holding entry itself - and sets *found to the entry it accepted.  Safe to run
+ alongside a writer - a slot being reused under us can only make match see an entry that doesn't hold the data, and
+ match has to check that anyway.  The slot may be reused again as soon as match returns, so lock free callers must
+ use *found rather than reading the entry back out of the slot */
+static struct llist_map_slot *hash_map_table_find(struct llist_map_table *table, uint64_t hash, void *entry,
+                                                  hash_map_match_fn match, const void *data, size_t d_size,
+                                                  void **found) {
+    size_t g_mask = table->n_slots / HASHMAP_GROUP - 1;
+    size_t group = hash_map_first_group(table, hash);
+    int8_t tag = hash_map_tag(hash);
+    for(size_t probe = 1; probe <= table->n_slots / HASHMAP_GROUP; probe++) {
+        const int8_t *ctrl = table->ctrl + group * HASHMAP_GROUP;
+        uint32_t tag_match = hash_map_group_match(ctrl, tag);
+        // Pairs with the release in hash_map_place - the slots behind any tags we saw are filled in
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        while(tag_match) {
+            struct llist_map_slot *slot = &table->slots[group * HASHMAP_GROUP + __builtin_ctz(tag_match)];
+            void *slot_entry = __atomic_load_n(&slot->entry, __ATOMIC_RELAXED);
+            if(__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == hash &&
+               (match ? match(slot_entry, hash, data, d_size) : slot_entry == entry)) {
+                *found = slot_entry;
+                return slot;
+            }
+            tag_match &= tag_match - 1;
+        }
+        if(hash_map_group_empty(ctrl))
+            return NULL;
+        group = (group + probe) & g_mask;
+    }
+    return NULL;
+}
+
+/* hash_map_table_erase marks a slot found by hash_map_table_find as free.  The slot contents are left alone, so a
+ lookup that matched the tag just before the erase still reads a whole entry */
+static void hash_map_table_erase(struct llist_map_table *table, struct llist_map_slot *slot) {
+    size_t index = slot - table->slots;
+    const int8_t *ctrl = table->ctrl + (index & ~(size_t)(HASHMAP_GROUP - 1));
+    // A probe that reaches a group with an empty slot stops there, so if this group already has one
+    // the slot can go straight back to empty instead of leaving a deleted marker behind
+    if(hash_map_group_empty(ctrl)) {
+        __atomic_store_n(&table->ctrl[index], HASHMAP_CTRL_EMPTY, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&table->ctrl[index], HASHMAP_CTRL_DELETED, __ATOMIC_RELAXED);
+        table->deleted++;
+    }
+}
+
+/* hash_map_stripe returns the stripe that entries with this hash live in */
+static inline struct llist_map_stripe *hash_map_stripe(struct llist_map *map, uint64_t hash) {
+    return &map->stripes[hash >> (64 - HASHMAP_STRIPE_BITS)];
+}
+
+/* hash_map_migrate copies up to n_slots slots of a stripe's old table into its current one, retiring the old table
+ once the last of it has been copied.  Entries stay in the old table as they are copied, so a lookup that checks the
+ current table and then the old one always finds them.  The caller must hold the stripe lock */
+static void hash_map_migrate(struct llist_map_stripe *stripe, size_t n_slots) {
+    struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_relaxed);
+    if(!old)
+        return;
+    struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_relaxed);
+    size_t end = stripe->migrate_pos + n_slots;
+    if(end > old->n_slots)
+        end = old->n_slots;
+    for(; stripe->migrate_pos < end; stripe->migrate_pos++) {
+        if(!HASHMAP_CTRL_FULL(old->ctrl[stripe->migrate_pos]))
+            continue;
+        hash_map_place(cur, old->slots[stripe->migrate_pos].entry, old->slots[stripe->migrate_pos].hash);
+        old->used--;
+    }
+    if(stripe->migrate_pos == old->n_slots) {
+        // Release so a lookup that sees no old table also sees everything we copied out of it
+        atomic_store_explicit(&stripe->old, NULL, memory_order_release);
+        hash_map_retire(old);
+        stripe->migrate_pos = 0;
+    }
+}
+
+/* hash_map_finish copies whatever is left of a running migration across */
+static inline void hash_map_finish(struct llist_map_stripe *stripe) {
+    struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_relaxed);
+    if(old)
+        hash_map_migrate(stripe, old->n_slots);
+}
+
+/* hash_map_grow starts migrating a stripe into a new table of n_slots slots.  If a migration is still running it
+ is finished first, so there are never more than two tables.  The current table is published as the old one before
+ the new table replaces it, so a lookup that sees the new table also sees the old one */
+static int hash_map_grow(struct llist_map_stripe *stripe, size_t n_slots) {
+    hash_map_finish(stripe);
+    struct llist_map_table *table = hash_map_alloc(n_slots);
+    if(!table)
+        return -1;
+    atomic_store_explicit(&stripe->old, atomic_load_explicit(&stripe->cur, memory_order_relaxed), memory_order_release);
+    atomic_store_explicit(&stripe->cur, table, memory_order_release);
+    stripe->migrate_pos = 0;
+    return 0;
+}
+
+/* hash_map_slots_for returns the table size a stripe needs to hold n_entries entries without growing */
+static inline size_t hash_map_slots_for(size_t n_entries) {
+    size_t n_slots = HASHMAP_MIN_SIZE;
+    while(n_slots * HASHMAP_MAX_LOAD_PCT / 100 < n_entries)
+        n_slots *= 2;
+    return n_slots;
+}
+
+/* hash_map_new creates an empty hash index with room for n_entries entries before it has to grow.  Stripes only
+ get a table up front when n_entries needs more than the smallest one - otherwise their tables are allocated by the
+ first insert into them, so small and empty indexes don't pay for sixteen tables they may never use */
+struct llist_map *hash_map_new(size_t n_entries) {
+    struct llist_map *map = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_map));
+    if(!map)
+        return NULL;
+    // Hashes spread entries evenly over the stripes, with a little slack for the ones that get more than their share
+    size_t n_slots = hash_map_slots_for(n_entries / HASHMAP_STRIPES + n_entries / (HASHMAP_STRIPES * 8));
+    for(int i = 0; i < HASHMAP_STRIPES; i++) {
+        struct llist_map_stripe *stripe = &map->stripes[i];
+        struct llist_map_table *table = NULL;
+        if(n_slots > HASHMAP_MIN_SIZE && !(table = hash_map_alloc(n_slots))) {
+            while(i--)
+                free(atomic_load(&map->stripes[i].cur));
+            free(map);
+            return NULL;
+        }
+        atomic_init(&stripe->lock, LLIST_LOCK_FREE);
+        atomic_init(&stripe->cur, table);
+        atomic_init(&stripe->old, NULL);
+        stripe->migrate_pos = 0;
+    }
+    return map;
+}
+
+/* hash_map_free frees the hash index straight away, so no reader may still be using it - the indexed entries
+ themselves are untouched */
+void hash_map_free(struct llist_map *map) {
+    if(!map)
+        return;
+    for(int i = 0; i < HASHMAP_STRIPES; i++) {
+        free(atomic_load(&map->stripes[i].cur));
+        free(atomic_load(&map->stripes[i].old));
+    }
+    free(map);
+}
+
+/* hash_map_lock takes the lock of the stripe that entries with this hash live in.  Anything modifying the index
+ has to hold the stripe lock for the hashes it touches - lookups never need it */
+void hash_map_lock(struct llist_map *map, uint64_t hash) {
+    llist_adaptive_lock(&hash_map_stripe(map, hash)->lock);
+}
+
+/* hash_map_unlock releases a stripe lock taken with hash_map_lock */
+void hash_map_unlock(struct llist_map *map, uint64_t hash) {
+    llist_adaptive_unlock(&hash_map_stripe(map, hash)->lock);
+}
+
+/* hash_map_lock_all takes every stripe lock, in order, for changes to the whole index */
+void hash_map_lock_all(struct llist_map *map) {
+    for(int i = 0; i < HASHMAP_STRIPES; i++)
+        llist_adaptive_lock(&map->stripes[i].lock);
+}
+
+/* hash_map_unlock_all releases the stripe locks taken with hash_map_lock_all */
+void hash_map_unlock_all(struct llist_map *map) {
+    for(int i = 0; i < HASHMAP_STRIPES; i++)
+        llist_adaptive_unlock(&map->stripes[i].lock);
+}
+
+/* hash_map_replace swaps the tables of from into map, retiring the tables map had and freeing from.  Lookups see
+ either the old contents of a stripe or the new, never a partly built one, so an index can be rebuilt off to the
+ side and then published in one go.  The caller must hold every stripe lock of map, and from must not have been
+ published anywhere */
+void hash_map_replace(struct llist_map *map, struct llist_map *from) {
+    for(int i = 0; i < HASHMAP_STRIPES; i++) {
+        struct llist_map_stripe *stripe = &map->stripes[i];
+        // With both migrations finished each stripe is a single complete table, so one pointer swap is all
+        // lookups see
+        hash_map_finish(stripe);
+        hash_map_finish(&from->stripes[i]);
+        struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_relaxed);
+        atomic_store_explicit(&stripe->cur, atomic_load_explicit(&from->stripes[i].cur, memory_order_relaxed),
+                              memory_order_release);
+        if(cur)
+            hash_map_retire(cur);
+    }
+    free(from);
+}
+
+/* hash_map_reserve makes sure the stripe for hash has room for one more entry, so the next hash_map_insert of that
+ hash can't fail.  Once an insert would take full and deleted slots past HASHMAP_MAX_LOAD_PCT - counting entries
+ still waiting to be migrated - a new table is started, double the size if full slots make up most of the load or
+ the same size if it is mostly deleted slots, and entries are migrated into it a few slots per operation so no
+ single insert pays for the whole rehash.  A stripe that has no table yet gets its first one here.
+ The caller must hold the stripe lock.  Returns -1 on failure */
+int hash_map_reserve(struct llist_map *map, uint64_t hash) {
+    if(!map)
+        return -1;
+    struct llist_map_stripe *stripe = hash_map_stripe(map, hash);
+    struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_relaxed);
+    if(!cur) {
+        if(!(cur = hash_map_alloc(HASHMAP_MIN_SIZE))) {
+            printf("Failed allocating hash map table\n");
+            return -1;
+        }
+        atomic_store_explicit(&stripe->cur, cur, memory_order_release);
+        return 0;
+    }
+    hash_map_migrate(stripe, HASHMAP_MIGRATE_SLOTS);
+    cur = atomic_load_explicit(&stripe->cur, memory_order_relaxed);
+    struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_relaxed);
+    size_t old_used = old ? old->used : 0;
+    if((cur->used + cur->deleted + old_used + 1) * 100 > cur->n_slots * HASHMAP_MAX_LOAD_PCT) {
+        size_t n_slots = cur->n_slots;
+        if((cur->used + old_used + 1) * 200 > n_slots * HASHMAP_MAX_LOAD_PCT)
+            n_slots *= 2;
+        if(hash_map_grow(stripe, n_slots) < 0) {
+            printf("Failed allocating while resizing hash map\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* hash_map_insert adds entry to the index under hash.  Entries are not checked for duplicates, so the same data
+ may be indexed once per entry holding it.  The caller must hold the stripe lock for hash, unless the index hasn't
+ been published yet */
+int hash_map_insert(struct llist_map *map, void *entry, uint64_t hash) {
+    if(hash_map_reserve(map, hash) < 0)
+        return -1;
+    hash_map_place(atomic_load_explicit(&hash_map_stripe(map, hash)->cur, memory_order_relaxed), entry, hash);
+    return 0;
+}
+
+/* hash_map_erase removes entry from the index, matching on the entry pointer rather than its data so that an
+ entry with duplicate data is never removed in its place.  While a stripe is growing the entry is removed from
+ both its tables.  The caller must hold the stripe lock for hash.  Returns true if the entry was found */
+bool hash_map_erase(struct llist_map *map, void *entry, uint64_t hash) {
+    struct llist_map_slot *slot;
+    void *erased;
+    bool found = false;
+    if(!map)
+        return false;
+    struct llist_map_stripe *stripe = hash_map_stripe(map, hash);
+    hash_map_migrate(stripe, HASHMAP_MIGRATE_SLOTS);
+    struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_relaxed);
+    struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_relaxed);
+    if(!cur)
+        return false;
+    if((slot = hash_map_table_find(cur, hash, entry, NULL, NULL, 0, &erased))) {
+        hash_map_table_erase(cur, slot);
+        cur->used--;
+        found = true;
+    }
+    if(old && (slot = hash_map_table_find(old, hash, entry, NULL, NULL, 0, &erased))) {
+        hash_map_table_erase(old, slot);
+        // Only entries that haven't been copied across yet are counted in the old table
+        if((size_t)(slot - old->slots) >= stripe->migrate_pos) {
+            old->used--;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/* hash_map_find returns the first indexed entry with a matching hash for which match returns true, or NULL.
+ Only slots whose control byte matches the hash tag and whose full hash matches are handed to match.
+ This never modifies the index and takes no lock, so it can run alongside writers as long as the caller is inside
+ an epoch critical section, and it never waits on anything - every probe is bounded by the table size */
+void *hash_map_find(struct llist_map *map, uint64_t hash, hash_map_match_fn match, const void *data, size_t d_size) {
+    void *found;
+    if(!map)
+        return NULL;
+    struct llist_map_stripe *stripe = hash_map_stripe(map, hash);
+    // cur before old - hash_map_grow publishes them the other way round, so if we see a new current table we
+    // also see the old table being migrated into it (or NULL once every entry has been copied across)
+    struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_acquire);
+    struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_acquire);
+    if(!cur)
+        return NULL;
+    if(hash_map_table_find(cur, hash, NULL, match, data, d_size, &found))
+        return found;
+    if(old && hash_map_table_find(old, hash, NULL, match, data, d_size, &found))
+        return found;
+    return NULL;
+}
+
+/* hash_map_next returns the next slot in use at or after position *pos and moves *pos past it, or returns NULL
+ once the end of the index is reached.  Start iterating with *pos set to 0.  Stripes are walked in turn - within
+ a growing stripe the current table is walked first, then whatever is left to migrate from the old table.  The
+ index must not change while it is being walked */
+struct llist_map_slot *hash_map_next(struct llist_map *map, size_t *pos) {
+    if(!map)
+        return NULL;
+    for(size_t i = *pos >> HASHMAP_POS_SHIFT; i < HASHMAP_STRIPES; i++, *pos = i << HASHMAP_POS_SHIFT) {
+        struct llist_map_stripe *stripe = &map->stripes[i];
+        struct llist_map_table *cur = atomic_load_explicit(&stripe->cur, memory_order_acquire);
+        struct llist_map_table *old = atomic_load_explicit(&stripe->old, memory_order_acquire);
+        size_t base = i << HASHMAP_POS_SHIFT;
+        if(!cur)
+            continue;
+        while(*pos - base < cur->n_slots) {
+            size_t slot = (*pos)++ - base;
+            if(HASHMAP_CTRL_FULL(cur->ctrl[slot]))
+                return &cur->slots[slot];
+        }
+        if(!old)
+            continue;
+        if(*pos - base < cur->n_slots + stripe->migrate_pos)
+            *pos = base + cur->n_slots + stripe->migrate_pos;
+        while(*pos - base < cur->n_slots + old->n_slots) {
+            size_t slot = (*pos)++ - base - cur->n_slots;
+            if(HASHMAP_CTRL_FULL(old->ctrl[slot]))
+                return &old->slots[slot];
+        }
+    }
+    return NULL;
+}
+
+/* hash_map_prefetch starts pulling in the first control group and slots a lookup of hash will probe, so a batch
+ of lookups can overlap their cache misses */
+void hash_map_prefetch(struct llist_map *map, uint64_t hash) {
+    if(!map)
+        return;
+    struct llist_map_table *cur = atomic_load_explicit(&hash_map_stripe(map, hash)->cur, memory_order_acquire);
+    if(!cur)
+        return;
+    size_t group = hash_map_first_group(cur, hash);
+    __builtin_prefetch(cur->ctrl + group * HASHMAP_GROUP);
+    __builtin_prefetch(&cur->slots[group * HASHMAP_GROUP + (hash & (HASHMAP_GROUP - 1))]);
+}
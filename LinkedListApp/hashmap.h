@@ -0,0 +1,95 @@
+//
+//  hashmap.h
+//  LinkedListApp
+//
+//  Flat open addressing hash index used by the linked list containers.
+//  Entries live in one array of slots holding the entry pointer and its full 64 bit hash, with a parallel
+//  array of control bytes.  A control byte is either empty, deleted, or a tag made from the entry's hash,
+//  so a probe compares a whole group of control bytes against the hash tag with one SIMD compare and only
+//  touches slots whose tag matched.
+//  Lookups take no lock.  Tables are published through atomic pointers, a slot is filled in before its control byte
+//  is set, and tables that are replaced are retired through epoch.h rather than freed, so a lookup inside an epoch
+//  critical section always probes a complete table - whatever a writer is doing.
+//  The index is split into HASHMAP_STRIPES segments picked by the top bits of the hash, each with its own lock and
+//  tables, so writers only contend when their entries land in the same stripe.
+//
+
+#ifndef hashmap_h
+#define hashmap_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HASHMAP_GROUP 32 // Control bytes compared per probe step
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HASHMAP_GROUP 16
+#else
+#define HASHMAP_GROUP 16
+#endif
+
+#define HASHMAP_MIN_SIZE HASHMAP_GROUP // Smallest table allocated, sizes are always a power of two
+#define HASHMAP_MAX_LOAD_PCT 87 // Table is rehashed once full and deleted slots pass this percentage of the slots
+#define HASHMAP_MIGRATE_SLOTS 64 // Slots of the old table copied across by each operation while growing
+#define HASHMAP_CTRL_EMPTY ((int8_t)0x00) // Control byte for a slot that has never been used - zero so new tables need no memset
+#define HASHMAP_CTRL_DELETED ((int8_t)0x01) // Control byte for a slot whose entry was erased
+#define HASHMAP_CTRL_FULL(ctrl) ((ctrl) < 0) // Full slots have the top bit of their control byte set
+#define HASHMAP_STRIPE_BITS 4 // Top bits of the hash that pick the stripe an entry lives in
+#define HASHMAP_STRIPES (1 << HASHMAP_STRIPE_BITS) // Independently locked segments the index is split into
+#define HASHMAP_POS_SHIFT 48 // hash_map_next keeps the stripe it is walking above this bit of its position
+
+/* struct llist_map_slot is a single entry in the hash index */
+struct llist_map_slot {
+    void *entry; // Indexed entry - a struct llist * for the linked list containers
+    uint64_t hash; // Full 64 bit hash of the entry's data
+};
+
+/* struct llist_map_table is one table of slots, allocated along with its slots and control bytes in a single block
+ - a map has two of these while it is growing */
+struct llist_map_table {
+    size_t n_slots; // Number of slots, always a power of two and a multiple of HASHMAP_GROUP - fixed once published
+    size_t used; // Number of full slots - for a table being migrated, the number not yet copied across
+    size_t deleted; // Number of deleted slots
+    int8_t *ctrl; // One control byte per slot - empty, deleted, or the top bit plus the low 7 bits of the slot hash
+    struct llist_map_slot slots[]; // n_slots slots, the control bytes follow directly after the last slot
+};
+
+/* struct llist_map_stripe is one segment of the hash index.  Growing a stripe doesn't rehash everything in one go -
+ a new table is allocated and the old one is copied into it HASHMAP_MIGRATE_SLOTS slots at a time by later inserts
+ and deletes, with both tables consulted until the copy is done.  Only the table pointers are read by lookups,
+ everything else belongs to whoever holds the stripe lock.  Each stripe starts on its own cache line so threads
+ working on different stripes don't fight over lines */
+struct llist_map_stripe {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint32_t) lock; // Spin lock held by anything modifying the stripe
+    _Atomic(struct llist_map_table *) cur; // Table new entries are inserted into - NULL until the first insert
+    _Atomic(struct llist_map_table *) old; // Table being migrated into cur - NULL when no migration is running
+    size_t migrate_pos; // Next slot of old to copy into cur
+};
+
+/* struct llist_map is the hash index itself */
+struct llist_map {
+    struct llist_map_stripe stripes[HASHMAP_STRIPES];
+};
+/* hash_map_match_fn returns true if entry holds the data being looked up - hash is the hash of that data */
+typedef bool (*hash_map_match_fn)(void *entry, uint64_t hash, const void *data, size_t d_size);
+
+struct llist_map *hash_map_new(size_t n_entries);
+void hash_map_free(struct llist_map *map);
+void hash_map_replace(struct llist_map *map, struct llist_map *from);
+void hash_map_lock(struct llist_map *map, uint64_t hash);
+void hash_map_unlock(struct llist_map *map, uint64_t hash);
+void hash_map_lock_all(struct llist_map *map);
+void hash_map_unlock_all(struct llist_map *map);
+int hash_map_reserve(struct llist_map *map, uint64_t hash);
+int hash_map_insert(struct llist_map *map, void *entry, uint64_t hash);
+bool hash_map_erase(struct llist_map *map, void *entry, uint64_t hash);
+void *hash_map_find(struct llist_map *map, uint64_t hash, hash_map_match_fn match, const void *data, size_t d_size);
+struct llist_map_slot *hash_map_next(struct llist_map *map, size_t *pos);
+void hash_map_prefetch(struct llist_map *map, uint64_t hash);
+
+#endif /* hashmap_h */
@@ -0,0 +1,163 @@
+//
+//  hazard.c
+//  LinkedListApp
+//
+//  Hazard pointer reclamation - thread registration, scanning the published hazards and freeing retired objects.
+//
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include "hazard.h"
+
+_Thread_local struct llist_hazard_thread *llist_hazard_self; // This thread's record, NULL until first registered
+static _Atomic(struct llist_hazard_thread *) llist_hazard_threads; // Every thread record ever allocated
+static _Atomic(size_t) llist_hazard_n_threads; // Number of records on llist_hazard_threads
+static pthread_key_t llist_hazard_key; // Runs llist_hazard_thread_exit when a registered thread exits
+static pthread_once_t llist_hazard_key_once = PTHREAD_ONCE_INIT;
+
+/* llist_hazard_thread_exit withdraws a thread's hazards when it exits and hands its record back, leaving anything it
+ retired that is still protected for whichever thread picks the record up next */
+static void llist_hazard_thread_exit(void *ptr) {
+    struct llist_hazard_thread *self = ptr;
+    for(int i = 0; i < LLIST_HAZARD_SLOTS; i++)
+        atomic_store_explicit(&self->hp[i], NULL, memory_order_release);
+    llist_hazard_scan();
+    llist_hazard_self = NULL;
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+}
+
+/* llist_hazard_key_create creates the key used to catch thread exits */
+static void llist_hazard_key_create(void) {
+    pthread_key_create(&llist_hazard_key, llist_hazard_thread_exit);
+}
+
+/* llist_hazard_register sets up the hazard record for the calling thread, reusing the record of a thread that has
+ exited if there is one.  Returns the record, or NULL on failure */
+struct llist_hazard_thread *llist_hazard_register(void) {
+    struct llist_hazard_thread *self;
+    pthread_once(&llist_hazard_key_once, llist_hazard_key_create);
+    for(self = atomic_load_explicit(&llist_hazard_threads, memory_order_acquire); self; self = self->next) {
+        bool in_use = false;
+        if(!atomic_load_explicit(&self->in_use, memory_order_relaxed) &&
+           atomic_compare_exchange_strong_explicit(&self->in_use, &in_use, true, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+    if(!self) {
+        self = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_hazard_thread));
+        if(!self) {
+            printf("Failed allocating hazard pointer thread record\n");
+            return NULL;
+        }
+        memset(self, 0, sizeof(struct llist_hazard_thread));
+        for(int i = 0; i < LLIST_HAZARD_SLOTS; i++)
+            atomic_init(&self->hp[i], NULL);
+        atomic_init(&self->in_use, true);
+        self->next = atomic_load_explicit(&llist_hazard_threads, memory_order_relaxed);
+        while(!atomic_compare_exchange_weak_explicit(&llist_hazard_threads, &self->next, self,
+                                                     memory_order_release, memory_order_relaxed))
+            ;
+        atomic_fetch_add_explicit(&llist_hazard_n_threads, 1, memory_order_relaxed);
+    }
+    pthread_setspecific(llist_hazard_key, self);
+    llist_hazard_self = self;
+    return self;
+}
+
+/* llist_hazard_threshold returns how many retired objects are held before a scan.  It is at least twice the number
+ of hazard pointers that can be published, so every scan frees at least half of what it looks at however many
+ objects readers are holding on to */
+size_t llist_hazard_threshold(void) {
+    size_t threshold = 2 * LLIST_HAZARD_SLOTS * atomic_load_explicit(&llist_hazard_n_threads, memory_order_relaxed);
+    return threshold > LLIST_HAZARD_SCAN_MIN ? threshold : LLIST_HAZARD_SCAN_MIN;
+}
+
+/* llist_hazard_compare orders hazard pointers for sorting and searching */
+static int llist_hazard_compare(const void *a, const void *b) {
+    uintptr_t first = (uintptr_t)*(void * const *)a, second = (uintptr_t)*(void * const *)b;
+    return first < second ? -1 : first > second;
+}
+
+/* llist_hazard_snapshot fills set with every hazard pointer published right now, sorted so they can be searched.
+ Anything retired before the snapshot was taken and not in it can be freed.  Returns -1 on failure */
+int llist_hazard_snapshot(struct llist_hazard_set *set) {
+    size_t max_hazards = atomic_load_explicit(&llist_hazard_n_threads, memory_order_acquire) * LLIST_HAZARD_SLOTS;
+    set->n_hazards = 0;
+    set->hazards = malloc((max_hazards ? max_hazards : 1) * sizeof(void *));
+    if(!set->hazards)
+        return -1;
+    // Pairs with the seq_cst store in llist_hazard_protect - a reader either published before our loads below,
+    // or it read the pointer after it was unlinked and so never got hold of it
+    atomic_thread_fence(memory_order_seq_cst);
+    for(struct llist_hazard_thread *thread = atomic_load_explicit(&llist_hazard_threads, memory_order_acquire);
+        thread; thread = thread->next) {
+        for(int i = 0; i < LLIST_HAZARD_SLOTS; i++) {
+            void *hazard = atomic_load_explicit(&thread->hp[i], memory_order_acquire);
+            if(!hazard)
+                continue;
+            // Threads registered since we sized the array can still publish hazards, so make room for them
+            if(set->n_hazards == max_hazards) {
+                void **hazards = realloc(set->hazards, (max_hazards + LLIST_HAZARD_SCAN_MIN) * sizeof(void *));
+                if(!hazards) {
+                    free(set->hazards);
+                    return -1;
+                }
+                set->hazards = hazards;
+                max_hazards += LLIST_HAZARD_SCAN_MIN;
+            }
+            set->hazards[set->n_hazards++] = hazard;
+        }
+    }
+    qsort(set->hazards, set->n_hazards, sizeof(void *), llist_hazard_compare);
+    return 0;
+}
+
+/* llist_hazard_protected returns true if ptr is in a hazard snapshot */
+bool llist_hazard_protected(struct llist_hazard_set *set, void *ptr) {
+    return bsearch(&ptr, set->hazards, set->n_hazards, sizeof(void *), llist_hazard_compare) != NULL;
+}
+
+/* llist_hazard_scan frees everything this thread has retired that no hazard pointer protects */
+void llist_hazard_scan(void) {
+    struct llist_hazard_thread *self = llist_hazard_self;
+    struct llist_hazard_set set;
+    size_t kept = 0;
+    if(!self || !self->n_retired || llist_hazard_snapshot(&set) < 0)
+        return;
+    for(size_t i = 0; i < self->n_retired; i++) {
+        if(llist_hazard_protected(&set, self->retired[i].guard))
+            self->retired[kept++] = self->retired[i];
+        else
+            self->retired[i].free_fn(self->retired[i].ptr);
+    }
+    self->n_retired = kept;
+    free(set.hazards);
+}
+
+/* llist_hazard_retire hands ptr over to be freed with free_fn once no thread has guard published as a hazard.  The
+ caller must already have made guard unreachable.  Once the thread holds llist_hazard_threshold retired objects the
+ hazards are scanned and everything unprotected is freed, so what a thread holds stays bounded.  Returns -1 if ptr
+ couldn't be queued, in which case it is leaked rather than freed early */
+int llist_hazard_retire(void *ptr, void *guard, void (*free_fn)(void *ptr)) {
+    struct llist_hazard_thread *self = llist_hazard_self;
+    if(!ptr)
+        return 0;
+    if(!self && !(self = llist_hazard_register()))
+        return -1;
+    if(self->n_retired == self->max_retired) {
+        size_t max_retired = self->max_retired ? self->max_retired * 2 : LLIST_HAZARD_SCAN_MIN;
+        struct llist_hazard_retired *retired = realloc(self->retired, max_retired * sizeof(struct llist_hazard_retired));
+        if(!retired) {
+            printf("Failed growing hazard retire list, leaking %p\n", ptr);
+            return -1;
+        }
+        self->retired = retired;
+        self->max_retired = max_retired;
+    }
+    self->retired[self->n_retired].ptr = ptr;
+    self->retired[self->n_retired].guard = guard;
+    self->retired[self->n_retired].free_fn = free_fn;
+    if(++self->n_retired >= llist_hazard_threshold())
+        llist_hazard_scan();
+    return 0;
+}
@@ -0,0 +1,74 @@
+//
+//  hazard.h
+//  LinkedListApp
+//
+//  Hazard pointer reclamation.  A reader publishes the address of the object it is about to use in one of its
+//  hazard slots, and an object that has been unlinked is only freed once a scan of every thread's slots finds no
+//  hazard pointing at it.  Unlike epochs a stalled reader only ever holds back the few objects it has published, so
+//  the memory waiting to be freed stays bounded - at the cost of readers publishing each object they use.
+//
+
+#ifndef hazard_h
+#define hazard_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#define LLIST_HAZARD_SLOTS 2 // Hazard pointers each thread can publish at once
+#define LLIST_HAZARD_FIND 0 // Slot llist_find leaves its result published in for hazard pointer containers
+#define LLIST_HAZARD_SCAN_MIN 64 // Fewest retired objects a thread or container holds before scanning the hazards
+
+/* struct llist_hazard_retired is an object waiting until no hazard pointer points at its guard */
+struct llist_hazard_retired {
+    void *ptr;
+    void *guard; // Address readers publish to protect ptr - ptr itself, or the node holding ptr
+    void (*free_fn)(void *ptr);
+};
+
+/* struct llist_hazard_thread holds the hazard pointers of one thread.  Like epoch records these are never freed -
+ a thread that exits clears its hazards and leaves its record, and anything it retired, to the next new thread */
+struct llist_hazard_thread {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(void *) hp[LLIST_HAZARD_SLOTS]; // Published hazard pointers, NULL if unused
+    _Atomic(bool) in_use; // Cleared when the owning thread exits
+    struct llist_hazard_retired *retired; // Objects retired by this thread that were still protected at the last scan
+    size_t n_retired;
+    size_t max_retired; // Size of the retired array
+    struct llist_hazard_thread *next; // Next record in the list of every thread record
+};
+
+/* struct llist_hazard_set is a sorted snapshot of every published hazard pointer, taken by a scan */
+struct llist_hazard_set {
+    void **hazards;
+    size_t n_hazards;
+};
+
+extern _Thread_local struct llist_hazard_thread *llist_hazard_self;
+
+struct llist_hazard_thread *llist_hazard_register(void);
+size_t llist_hazard_threshold(void);
+int llist_hazard_snapshot(struct llist_hazard_set *set);
+bool llist_hazard_protected(struct llist_hazard_set *set, void *ptr);
+int llist_hazard_retire(void *ptr, void *guard, void (*free_fn)(void *ptr));
+void llist_hazard_scan(void);
+
+/* llist_hazard_protect publishes ptr in one of the calling thread's hazard slots, replacing whatever was there.
+ The caller must know ptr can't have been retired before this returns - by holding a lock that keeps it linked,
+ or by reading it again afterwards and checking it hasn't changed.  Returns -1 if the thread couldn't be registered */
+static inline int llist_hazard_protect(int slot, void *ptr) {
+    struct llist_hazard_thread *self = llist_hazard_self;
+    if(!self && !(self = llist_hazard_register()))
+        return -1;
+    atomic_store_explicit(&self->hp[slot], ptr, memory_order_seq_cst);
+    return 0;
+}
+
+/* llist_hazard_clear withdraws the hazard pointer in one of the calling thread's slots */
+static inline void llist_hazard_clear(int slot) {
+    if(llist_hazard_self)
+        atomic_store_explicit(&llist_hazard_self->hp[slot], NULL, memory_order_release);
+}
+
+#endif /* hazard_h */
@@ -0,0 +1,326 @@
+//
+//  intrusive.c
+//  LinkedListApp
+//
+//  Intrusive linked list - linking caller owned entries and keeping their hash index up to date.
+//
+
+#include <stdio.h>
+#include "list.h"
+#include "intrusive.h"
+
+#ifdef USE_LOCK
+#define INTRUSIVE_LOCK(cont) llist_spin_lock(&(cont)->locked)
+#define INTRUSIVE_UNLOCK(cont) llist_spin_unlock(&(cont)->locked)
+#else
+#define INTRUSIVE_LOCK(cont) ({})
+#define INTRUSIVE_UNLOCK(cont) ({})
+#endif
+
+/* struct llist_link_lookup is what llist_link_find hands the index to match entries against */
+struct llist_link_lookup {
+    llist_link_key_fn key;
+    const void *data;
+    size_t d_size;
+};
+
+/* intrusive_container_new creates an empty intrusive list.  If key is set the container keeps a hash index of its
+ entries by the key key returns for them, for llist_link_find */
+struct llist_intrusive_container *intrusive_container_new(llist_link_key_fn key) {
+    struct llist_intrusive_container *new = calloc(1, sizeof(struct llist_intrusive_container));
+    if(!new)
+        return NULL;
+    atomic_init(&new->locked, LLIST_LOCK_FREE);
+    new->key = key;
+    if(key) {
+        new->h_map = hash_map_new(0);
+        if(!new->h_map) {
+            free(new);
+            return NULL;
+        }
+    }
+    return new;
+}
+
+/* intrusive_container_free frees an intrusive list.  The entries belong to the caller - if release is set it is
+ called on every entry still linked, so the caller can free them */
+void intrusive_container_free(struct llist_intrusive_container *cont, void (*release)(struct llist_link *link)) {
+    struct llist_link *link, *next;
+    if(!cont)
+        return;
+    if(release) {
+        for(link = cont->head; link; link = next) {
+            next = link->next;
+            release(link);
+        }
+    }
+    hash_map_free(cont->h_map);
+    free(cont);
+}
+
+/* llist_link_hash works out the hash of the key of link, returning false if it has no key to index it under */
+static inline bool llist_link_hash(struct llist_intrusive_container *cont, struct llist_link *link) {
+    size_t k_size = 0;
+    const void *key = cont->key(link, &k_size);
+    if(!key || k_size == 0)
+        return false;
+    link->hash = XXH3_64bits(key, k_size);
+    return true;
+}
+
+/* llist_link_reserve takes the index stripe lock for an entry about to be linked in and makes room for it, so
+ indexing it once it is linked can't fail.  On success the stripe lock is left held for llist_link_index and *indexed
+ says whether there was anything to index.  The caller must hold the container lock.  Returns -1 on failure */
+static int llist_link_reserve(struct llist_intrusive_container *cont, struct llist_link *link, bool *indexed) {
+    *indexed = cont->h_map && llist_link_hash(cont, link);
+    if(!*indexed)
+        return 0;
+    hash_map_lock(cont->h_map, link->hash);
+    if(hash_map_reserve(cont->h_map, link->hash) < 0) {
+        hash_map_unlock(cont->h_map, link->hash);
+        printf("Failed growing intrusive list index\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* llist_link_index indexes an entry that has been linked in, after llist_link_reserve */
+static inline void llist_link_index(struct llist_intrusive_container *cont, struct llist_link *link, bool indexed) {
+    link->indexed = indexed;
+    if(!indexed)
+        return;
+    // Can't fail - llist_link_reserve made room under the stripe lock we still hold
+    hash_map_insert(cont->h_map, link, link->hash);
+    hash_map_unlock(cont->h_map, link->hash);
+}
+
+/* llist_link_unindex takes an entry out of the index, if it is in there.  Entries without a key were never indexed
+ and their hash is whatever was left there, so they are skipped.  The caller must hold the container lock */
+static inline void llist_link_unindex(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(!cont->h_map || !link->indexed)
+        return;
+    hash_map_lock(cont->h_map, link->hash);
+    hash_map_erase(cont->h_map, link, link->hash);
+    hash_map_unlock(cont->h_map, link->hash);
+    link->indexed = false;
+}
+
+/* llist_link_between links link in between prev and next, either of which may be NULL at the ends of the list.
+ The caller must hold the container lock */
+static inline void llist_link_between(struct llist_intrusive_container *cont, struct llist_link *prev,
+                                      struct llist_link *next, struct llist_link *link) {
+    link->prev = prev;
+    link->next = next;
+    if(prev)
+        prev->next = link;
+    else
+        cont->head = link;
+    if(next)
+        next->prev = link;
+    else
+        cont->tail = link;
+    cont->list_entries++;
+}
+
+/* llist_link_add links link in between prev and next and indexes it */
+static int llist_link_add(struct llist_intrusive_container *cont, struct llist_link *prev, struct llist_link *next,
+                          struct llist_link *link) {
+    bool indexed;
+    if(llist_link_reserve(cont, link, &indexed) < 0)
+        return -1;
+    llist_link_between(cont, prev, next, link);
+    llist_link_index(cont, link, indexed);
+    return 0;
+}
+
+/* llist_link_add_head links an entry in at the head of the list */
+int llist_link_add_head(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(!cont || !link)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    int ret = llist_link_add(cont, NULL, cont->head, link);
+    INTRUSIVE_UNLOCK(cont);
+    // Growing the index retires the tables it replaces, free them now we aren't holding the lock
+    llist_epoch_poll();
+    return ret;
+}
+
+/* llist_link_add_tail links an entry in at the tail of the list */
+int llist_link_add_tail(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(!cont || !link)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    int ret = llist_link_add(cont, cont->tail, NULL, link);
+    INTRUSIVE_UNLOCK(cont);
+    llist_epoch_poll();
+    return ret;
+}
+
+/* llist_link_insert_between links an entry in between two adjacent entries */
+int llist_link_insert_between(struct llist_intrusive_container *cont, struct llist_link *first,
+                              struct llist_link *second, struct llist_link *link) {
+    if(!cont || !first || !second || !link)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    if(first->next != second || second->prev != first) {
+        printf("Specified entries are non-adjacent\n");
+        INTRUSIVE_UNLOCK(cont);
+        return -1;
+    }
+    int ret = llist_link_add(cont, first, second, link);
+    INTRUSIVE_UNLOCK(cont);
+    llist_epoch_poll();
+    return ret;
+}
+
+/* llist_link_refresh_outer points the neighbours of link back at it, moving the head or tail to it if it has
+ become the first or last entry */
+static inline void llist_link_refresh_outer(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(link->prev)
+        link->prev->next = link;
+    else
+        cont->head = link;
+    if(link->next)
+        link->next->prev = link;
+    else
+        cont->tail = link;
+}
+
+/* llist_link_swap_entries swaps the positions of two entries in the list */
+int llist_link_swap_entries(struct llist_intrusive_container *cont, struct llist_link *first, struct llist_link *second) {
+    struct llist_link *temp;
+    if(!cont || !first || !second) {
+        printf("One of the entries in the attempted swap was NULL, bailing\n");
+        return -1;
+    }
+    if(first == second)
+        return 0;
+    INTRUSIVE_LOCK(cont);
+    if(second->next == first) {
+        temp = first;
+        first = second;
+        second = temp;
+    }
+    struct llist_link *first_prev = first->prev, *first_next = first->next;
+    struct llist_link *second_prev = second->prev, *second_next = second->next;
+    if(first_next == second) {
+        first->prev = second;
+        second->next = first;
+    } else {
+        first->prev = second_prev;
+        second->next = first_next;
+    }
+    first->next = second_next;
+    second->prev = first_prev;
+    llist_link_refresh_outer(cont, first);
+    llist_link_refresh_outer(cont, second);
+    INTRUSIVE_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_link_linked checks link is an entry of this list - its neighbours, or the head and tail at the ends, have
+ to point back at it.  A deleted entry has no neighbours and isn't the head.  The caller must hold the container
+ lock */
+static inline bool llist_link_linked(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(link->prev ? link->prev->next != link : cont->head != link)
+        return false;
+    return link->next ? link->next->prev == link : cont->tail == link;
+}
+
+/* llist_link_delete unlinks an entry from the list and its index.  The entry itself is left for the caller to free.
+ If it was the current entry the list pointer moves on to the next entry.  Returns -1 if the entry isn't linked into
+ this list, so deleting an entry twice leaves the list alone */
+int llist_link_delete(struct llist_intrusive_container *cont, struct llist_link *link) {
+    if(!cont || !link)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    if(!llist_link_linked(cont, link)) {
+        printf("Entry isn't linked into this list\n");
+        INTRUSIVE_UNLOCK(cont);
+        return -1;
+    }
+    if(link->prev)
+        link->prev->next = link->next;
+    else
+        cont->head = link->next;
+    if(link->next)
+        link->next->prev = link->prev;
+    else
+        cont->tail = link->prev;
+    if(cont->list == link)
+        cont->list = link->next;
+    cont->list_entries--;
+    llist_link_unindex(cont, link);
+    link->next = link->prev = NULL;
+    INTRUSIVE_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_link_rekey reindexes an entry after its key has been modified in place - the index finds entries by the
+ hash of their key worked out when they were linked, so until this is called the entry is found under its old key.
+ Returns -1 if the entry isn't linked into this list, or if it couldn't be indexed under its new key, leaving it
+ linked but out of the index */
+int llist_link_rekey(struct llist_intrusive_container *cont, struct llist_link *link) {
+    bool indexed;
+    if(!cont || !link)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    if(!llist_link_linked(cont, link)) {
+        printf("Entry isn't linked into this list\n");
+        INTRUSIVE_UNLOCK(cont);
+        return -1;
+    }
+    llist_link_unindex(cont, link);
+    if(llist_link_reserve(cont, link, &indexed) < 0) {
+        INTRUSIVE_UNLOCK(cont);
+        return -1;
+    }
+    llist_link_index(cont, link, indexed);
+    INTRUSIVE_UNLOCK(cont);
+    llist_epoch_poll();
+    return 0;
+}
+
+/* llist_link_match is the hash_map_match_fn used by llist_link_find - data is a struct llist_link_lookup, since the
+ key of an entry can only be got at through the container's key function */
+static bool llist_link_match(void *entry, uint64_t hash, const void *data, size_t d_size) {
+    const struct llist_link_lookup *lookup = data;
+    struct llist_link *link = entry;
+    size_t k_size = 0;
+    if(d_size != sizeof(struct llist_link_lookup) || link->hash != hash)
+        return false;
+    const void *key = lookup->key(link, &k_size);
+    return k_size == lookup->d_size && !memcmp(key, lookup->data, k_size);
+}
+
+/* llist_link_find looks up the entry with the given key through the container's index.  Entries may be freed by
+ their owner as soon as they are deleted, so unlike llist_find this takes the container lock rather than relying on
+ epoch reclamation - the entry is only safe to use for as long as the caller knows it won't be deleted.
+ Returns NULL if there is no such entry or the container isn't indexed */
+struct llist_link *llist_link_find(struct llist_intrusive_container *cont, const void *key, size_t k_size) {
+    if(!cont || !cont->h_map || !key || k_size == 0)
+        return NULL;
+    struct llist_link_lookup lookup = { .key = cont->key, .data = key, .d_size = k_size };
+    uint64_t hash = XXH3_64bits(key, k_size);
+    INTRUSIVE_LOCK(cont);
+    struct llist_link *link = hash_map_find(cont->h_map, hash, llist_link_match, &lookup, sizeof(lookup));
+    INTRUSIVE_UNLOCK(cont);
+    return link;
+}
+
+/* llist_link_foreach calls fn on every entry from head to tail, stopping early if fn returns false.  fn must not
+ link or delete entries.  Returns the number of entries visited, or -1 */
+long llist_link_foreach(struct llist_intrusive_container *cont, bool (*fn)(struct llist_link *link, void *arg),
+                        void *arg) {
+    long visited = 0;
+    if(!cont || !fn)
+        return -1;
+    INTRUSIVE_LOCK(cont);
+    for(struct llist_link *link = cont->head; link; link = link->next) {
+        visited++;
+        if(!fn(link, arg))
+            break;
+    }
+    INTRUSIVE_UNLOCK(cont);
+    return visited;
+}
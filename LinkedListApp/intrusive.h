@@ -0,0 +1,62 @@
+//
+//  intrusive.h
+//  LinkedListApp
+//
+//  Intrusive linked list - rather than the list allocating a struct llist that points at the caller's data, the
+//  caller embeds a struct llist_link in its own struct and the list links those together, getting back to the
+//  enclosing struct with llist_link_entry.  That saves a node allocation and a pointer dereference per entry.
+//  The list never allocates or frees the entries themselves - they belong to the caller, who must keep an entry
+//  alive for as long as it is linked.  Containers created with a key function keep a hash index of their entries,
+//  built on the same index the ordinary containers use, so entries can be looked up by key.
+//
+
+#ifndef intrusive_h
+#define intrusive_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "hashmap.h"
+#include "lock.h"
+
+/* llist_link_entry returns the struct of the given type that link is embedded in as member */
+#define llist_link_entry(link, type, member) ((type *)((char *)(link) - offsetof(type, member)))
+
+/* struct llist_link is embedded in each entry of an intrusive list */
+struct llist_link {
+    struct llist_link *next; // Next entry in linked list
+    struct llist_link *prev; // Previous entry in linked list
+    uint64_t hash; // XXH3_64bits of the entry's key, computed when the entry is linked into an indexed container
+    bool indexed; // Set while the entry is in the container's index under hash
+};
+
+/* llist_link_key_fn returns the key an entry is indexed under, setting *k_size to its size */
+typedef const void *(*llist_link_key_fn)(struct llist_link *link, size_t *k_size);
+
+/* struct llist_intrusive_container contains an intrusive list */
+struct llist_intrusive_container {
+    struct llist_link *list; // Linked list pointer that can point anywhere on the list
+    struct llist_link *head; // First entry, NULL if the list is empty
+    struct llist_link *tail; // Last entry
+    size_t list_entries;
+    llist_link_key_fn key; // Gives the key of each entry - NULL if the container isn't indexed
+    struct llist_map *h_map; // Hash index of the entries by key, only set if key is
+    _Atomic(uint32_t) locked; // Spin lock, taken around every operation if USE_LOCK is defined
+};
+
+struct llist_intrusive_container *intrusive_container_new(llist_link_key_fn key);
+void intrusive_container_free(struct llist_intrusive_container *cont, void (*release)(struct llist_link *link));
+int llist_link_add_head(struct llist_intrusive_container *cont, struct llist_link *link);
+int llist_link_add_tail(struct llist_intrusive_container *cont, struct llist_link *link);
+int llist_link_insert_between(struct llist_intrusive_container *cont, struct llist_link *first,
+                              struct llist_link *second, struct llist_link *link);
+int llist_link_swap_entries(struct llist_intrusive_container *cont, struct llist_link *first, struct llist_link *second);
+int llist_link_delete(struct llist_intrusive_container *cont, struct llist_link *link);
+int llist_link_rekey(struct llist_intrusive_container *cont, struct llist_link *link);
+struct llist_link *llist_link_find(struct llist_intrusive_container *cont, const void *key, size_t k_size);
+long llist_link_foreach(struct llist_intrusive_container *cont, bool (*fn)(struct llist_link *link, void *arg),
+                        void *arg);
+
+#endif /* intrusive_h */
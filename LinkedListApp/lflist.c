@@ -0,0 +1,232 @@
+//
+//  lflist.c
+//  LinkedListApp
+//
+//  Lock free linked list.
+//
+
+#include <string.h>
+#include <stdio.h>
+#include "xxHash/xxh3.h"
+#include "lflist.h"
+
+/* lf_ptr strips the mark bit off a next pointer */
+static inline struct llist_lf *lf_ptr(uintptr_t next) {
+    return (struct llist_lf *)(next & ~LLIST_LF_MARK);
+}
+
+/* lf_marked returns true if the entry a next pointer was read from has been deleted */
+static inline bool lf_marked(uintptr_t next) {
+    return next & LLIST_LF_MARK;
+}
+
+/* lf_compare orders an entry against the data being looked up - by hash, then size, then the data itself -
+ returning less than, equal to or greater than zero like memcmp */
+static inline int lf_compare(struct llist_lf *node, uint64_t hash, const void *data, size_t d_size) {
+    if(node->hash != hash)
+        return node->hash < hash ? -1 : 1;
+    if(node->data_size != d_size)
+        return node->data_size < d_size ? -1 : 1;
+    return memcmp(node->data, data, d_size);
+}
+
+/* lf_reclaim frees an entry once epoch reclamation has decided no thread can still be looking at it */
+static void lf_reclaim(void *ptr) {
+    struct llist_lf *node = ptr;
+    if(node->free_data && node->data)
+        free(node->data);
+    free(node);
+}
+
+/* lf_retire hands an entry that has just been unlinked over to epoch reclamation.  Only the thread whose CAS
+ unlinked the entry calls this, so each entry is retired exactly once */
+static void lf_retire(struct llist_lf_container *cont, struct llist_lf *node) {
+    llist_epoch_retire(node, lf_reclaim);
+    atomic_fetch_sub_explicit(&cont->list_entries, 1, memory_order_relaxed);
+}
+
+/* lf_search must be called inside an epoch critical section.  It finds the first live entry that doesn't sort before the data, returning it in *cur (NULL if the end of
+ the list was reached) along with the entry before it in *prev.  Deleted entries found along the way are unlinked.
+ Returns true if *cur holds the data */
+static bool lf_search(struct llist_lf_container *cont, uint64_t hash, const void *data, size_t d_size,
+                      struct llist_lf **prev, struct llist_lf **cur) {
+retry:
+    *prev = &cont->head;
+    *cur = lf_ptr(atomic_load_explicit(&cont->head.next, memory_order_acquire));
+    while(*cur) {
+        uintptr_t next = atomic_load_explicit(&(*cur)->next, memory_order_acquire);
+        if(lf_marked(next)) {
+            // *cur has been deleted, help unlink it - if our predecessor has changed under us start again
+            uintptr_t expected = (uintptr_t)*cur;
+            if(!atomic_compare_exchange_strong_explicit(&(*prev)->next, &expected, (uintptr_t)lf_ptr(next),
+                                                        memory_order_acq_rel, memory_order_acquire))
+                goto retry;
+            lf_retire(cont, *cur);
+            *cur = lf_ptr(next);
+            continue;
+        }
+        int cmp = lf_compare(*cur, hash, data, d_size);
+        if(cmp >= 0)
+            return cmp == 0;
+        *prev = *cur;
+        *cur = lf_ptr(next);
+    }
+    return false;
+}
+
+/* lf_container_new creates an empty lock free list container */
+struct llist_lf_container *lf_container_new(void) {
+    struct llist_lf_container *new = calloc(1, sizeof(struct llist_lf_container));
+    if(!new)
+        return NULL;
+    atomic_init(&new->head.next, 0);
+    atomic_init(&new->list_entries, 0);
+    return new;
+}
+
+/* lf_container_free frees the container and every entry still in it.  If free_data is true data is freed for the
+ entries still in the list - deleted entries free their data if the delete asked for it.  Entries that have already
+ been unlinked are left to epoch reclamation.  No other thread may be using the container */
+void lf_container_free(struct llist_lf_container *cont, bool free_data) {
+    struct llist_lf *node, *next;
+    if(!cont)
+        return;
+    for(node = lf_ptr(atomic_load(&cont->head.next)); node; node = next) {
+        next = lf_ptr(atomic_load(&node->next));
+        // Entries that were deleted but never unlinked follow the free_data choice of their delete
+        if((lf_marked(atomic_load(&node->next)) ? node->free_data : free_data) && node->data)
+            free(node->data);
+        free(node);
+    }
+    free(cont);
+}
+
+/* llist_lf_add_data adds data to the list in sorted position.  Returns 0 if it was added, 1 if the list already
+ holds the same data, or -1 on failure */
+int llist_lf_add_data(struct llist_lf_container *cont, void *data, size_t d_size) {
+    struct llist_lf *prev, *cur;
+    if(!cont || !data || d_size == 0)
+        return -1;
+    uint64_t hash = XXH3_64bits(data, d_size);
+    struct llist_lf *new = calloc(1, sizeof(struct llist_lf));
+    if(!new)
+        return -1;
+    new->data = data;
+    new->data_size = d_size;
+    new->hash = hash;
+    if(llist_epoch_enter() < 0) {
+        free(new);
+        return -1;
+    }
+    for(;;) {
+        if(lf_search(cont, hash, data, d_size, &prev, &cur)) {
+            llist_epoch_exit();
+            free(new);
+            return 1;
+        }
+        atomic_store_explicit(&new->next, (uintptr_t)cur, memory_order_relaxed);
+        uintptr_t expected = (uintptr_t)cur;
+        if(atomic_compare_exchange_strong_explicit(&prev->next, &expected, (uintptr_t)new,
+                                                   memory_order_release, memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&cont->list_entries, 1, memory_order_relaxed);
+            llist_epoch_exit();
+            return 0;
+        }
+    }
+}
+
+/* lf_delete marks cur as deleted and tries to unlink it - if the unlink loses a race a search is run to make sure
+ it is unlinked before we return.  Must be called inside an epoch critical section.  Returns 0 if we deleted it or
+ -1 if another thread got there first */
+static int lf_delete(struct llist_lf_container *cont, struct llist_lf *prev, struct llist_lf *cur, bool free_data) {
+    uintptr_t next = atomic_load_explicit(&cur->next, memory_order_acquire);
+    do {
+        if(lf_marked(next))
+            return -1;
+    } while(!atomic_compare_exchange_weak_explicit(&cur->next, &next, next | LLIST_LF_MARK,
+                                                   memory_order_acq_rel, memory_order_acquire));
+    // The entry is ours to delete now - another thread may unlink and retire it from here on, but it can't be
+    // freed until we leave our critical section, so this is seen in time
+    cur->free_data = free_data;
+    uintptr_t expected = (uintptr_t)cur;
+    if(atomic_compare_exchange_strong_explicit(&prev->next, &expected, next, memory_order_acq_rel, memory_order_relaxed))
+        lf_retire(cont, cur);
+    else
+        lf_search(cont, cur->hash, cur->data, cur->data_size, &prev, &cur);
+    return 0;
+}
+
+/* llist_lf_delete_data deletes the entry holding data.  If free_data is true the data is freed once the entry is.
+ Returns 0 if the entry was deleted or -1 if the data wasn't in the list */
+int llist_lf_delete_data(struct llist_lf_container *cont, const void *data, size_t d_size, bool free_data) {
+    struct llist_lf *prev, *cur;
+    if(!cont || !data || d_size == 0)
+        return -1;
+    uint64_t hash = XXH3_64bits(data, d_size);
+    int ret = -1;
+    if(llist_epoch_enter() < 0)
+        return -1;
+    while(lf_search(cont, hash, data, d_size, &prev, &cur)) {
+        if((ret = lf_delete(cont, prev, cur, free_data)) == 0)
+            break;
+    }
+    llist_epoch_exit();
+    return ret;
+}
+
+/* llist_lf_delete_node deletes node from the list.  The caller must have found node inside an epoch critical
+ section it is still in.  Returns 0 if the node was deleted or -1 if it wasn't in the list, which includes another
+ thread having deleted it first */
+int llist_lf_delete_node(struct llist_lf_container *cont, struct llist_lf *node, bool free_data) {
+    struct llist_lf *prev, *cur;
+    int ret = -1;
+    if(!cont || !node)
+        return -1;
+    if(llist_epoch_enter() < 0)
+        return -1;
+    if(lf_search(cont, node->hash, node->data, node->data_size, &prev, &cur) && cur == node)
+        ret = lf_delete(cont, prev, cur, free_data);
+    llist_epoch_exit();
+    return ret;
+}
+
+/* llist_lf_find returns the entry holding data, or NULL.  Finds never write to the list, they just step over
+ deleted entries.  The entry is only safe to use after this returns if the caller is inside an epoch critical
+ section */
+struct llist_lf *llist_lf_find(struct llist_lf_container *cont, const void *data, size_t d_size) {
+    struct llist_lf *found = NULL;
+    if(!cont || !data || d_size == 0)
+        return NULL;
+    uint64_t hash = XXH3_64bits(data, d_size);
+    if(llist_epoch_enter() < 0)
+        return NULL;
+    struct llist_lf *cur = lf_ptr(atomic_load_explicit(&cont->head.next, memory_order_acquire));
+    while(cur) {
+        uintptr_t next = atomic_load_explicit(&cur->next, memory_order_acquire);
+        int cmp = lf_compare(cur, hash, data, d_size);
+        if(cmp >= 0) {
+            if(cmp == 0 && !lf_marked(next))
+                found = cur;
+            break;
+        }
+        cur = lf_ptr(next);
+    }
+    llist_epoch_exit();
+    return found;
+}
+
+/* llist_lf_next returns the live entry after node, or the first live entry in the list if node is NULL.  Walking the
+ list must be done inside a single epoch critical section, so the entry we step from can't be freed under us */
+struct llist_lf *llist_lf_next(struct llist_lf_container *cont, struct llist_lf *node) {
+    if(!cont)
+        return NULL;
+    uintptr_t next = atomic_load_explicit(node ? &node->next : &cont->head.next, memory_order_acquire);
+    struct llist_lf *cur = lf_ptr(next);
+    while(cur) {
+        next = atomic_load_explicit(&cur->next, memory_order_acquire);
+        if(!lf_marked(next))
+            return cur;
+        cur = lf_ptr(next);
+    }
+    return NULL;
+}
@@ -0,0 +1,47 @@
+//
+//  lflist.h
+//  LinkedListApp
+//
+//  Lock free linked list - a Harris style sorted list where a node is deleted by first setting the low bit of its
+//  next pointer (marking it) and then unlinking it with a compare and exchange on its predecessor.  Every operation
+//  is a CAS on a next pointer, so any number of threads can add, delete and find concurrently without a lock.
+//  Entries are kept sorted by the hash of their data, which makes the list a set: data that is already present
+//  isn't added a second time.  Unlinked entries are retired through epoch.h, so an entry returned by llist_lf_find
+//  or llist_lf_next stays valid until the caller leaves the epoch critical section it was found in.
+//
+
+#ifndef lflist_h
+#define lflist_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "epoch.h"
+
+#define LLIST_LF_MARK ((uintptr_t)1) // Low bit of a next pointer, set once the node holding it is deleted
+
+/* struct llist_lf is an entry in a lock free list */
+struct llist_lf {
+    _Atomic(uintptr_t) next; // Next entry, with LLIST_LF_MARK set once this entry has been deleted
+    void *data; // Data in linked list
+    size_t data_size;
+    uint64_t hash; // XXH3_64bits of data - the list is sorted on this
+    bool free_data; // Set when the entry is deleted if data should be freed along with it
+};
+
+/* struct llist_lf_container contains a lock free list */
+struct llist_lf_container {
+    struct llist_lf head; // Sentinel entry before the first real entry, never deleted
+    _Atomic(size_t) list_entries;
+};
+
+struct llist_lf_container *lf_container_new(void);
+void lf_container_free(struct llist_lf_container *cont, bool free_data);
+int llist_lf_add_data(struct llist_lf_container *cont, void *data, size_t d_size);
+int llist_lf_delete_data(struct llist_lf_container *cont, const void *data, size_t d_size, bool free_data);
+int llist_lf_delete_node(struct llist_lf_container *cont, struct llist_lf *node, bool free_data);
+struct llist_lf *llist_lf_find(struct llist_lf_container *cont, const void *data, size_t d_size);
+struct llist_lf *llist_lf_next(struct llist_lf_container *cont, struct llist_lf *node);
+
+#endif /* lflist_h */
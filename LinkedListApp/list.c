@@ -8,24 +8,308 @@
 #include "list.h"
 // #include "xxHash.h"
 
-/* llist_new creates a new linked list entry with data*/
+/* llist_new creates a new linked list entry with data.  This is deliberately left outside any container's slab
+ pool - the node is calloc'd on its own and belongs to the caller.  Use llist_pool_new for a node carved out of a
+ container's pool instead */
 struct llist *llist_new(void *data, size_t d_size) {
     struct llist *new = calloc(1, sizeof(struct llist));
     if(!new)
         return NULL;
-    new->data = data;
-    new->data_size = d_size;
+    llist_set_node_data(new, data, d_size);
     return new;
 }
 
-/* container_new creates a new linked list container and the initial first linked list entry */
+/* llist_arena_alloc bump allocates size bytes from the arena, mapping a new block when the current one is full.
+ Memory is zeroed since it comes straight from mmap and is never reused.  The caller must hold the container lock */
+static void *llist_arena_alloc(struct llist_arena *arena, size_t size) {
+    struct llist_arena_block *block = arena->blocks;
+    size = (size + LLIST_ARENA_ALIGN - 1) & ~(size_t)(LLIST_ARENA_ALIGN - 1);
+    if(!block || block->size - block->used < size) {
+        size_t header = (sizeof(struct llist_arena_block) + LLIST_ARENA_ALIGN - 1) & ~(size_t)(LLIST_ARENA_ALIGN - 1);
+        size_t map_size = arena->next_block ? arena->next_block : LLIST_ARENA_BLOCK;
+        while(map_size - header < size)
+            map_size *= 2;
+        block = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(block == MAP_FAILED)
+            return NULL;
+        block->size = map_size;
+        block->used = header;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        if(map_size < LLIST_ARENA_MAX_BLOCK)
+            arena->next_block = map_size * 2;
+    }
+    void *ptr = (char *)block + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/* llist_arena_alloc_aligned bump allocates size bytes from the arena aligned to align, a power of two.  Arena
+ memory is only LLIST_ARENA_ALIGN aligned, so larger alignments take a little extra and round up within it.
+ The caller must hold the container lock */
+static void *llist_arena_alloc_aligned(struct llist_arena *arena, size_t size, size_t align) {
+    if(align <= LLIST_ARENA_ALIGN)
+        return llist_arena_alloc(arena, size);
+    char *ptr = llist_arena_alloc(arena, size + align);
+    if(!ptr)
+        return NULL;
+    return (void *)(((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+/* llist_arena_owns returns true if ptr was handed out by the arena */
+static bool llist_arena_owns(struct llist_arena *arena, void *ptr) {
+    for(struct llist_arena_block *block = arena->blocks; block; block = block->next) {
+        if((char *)ptr >= (char *)block && (char *)ptr < (char *)block + block->size)
+            return true;
+    }
+    return false;
+}
+
+/* llist_arena_release unmaps every block in the arena */
+static void llist_arena_release(struct llist_arena *arena) {
+    struct llist_arena_block *block = arena->blocks, *next;
+    while(block) {
+        next = block->next;
+        munmap(block, block->size);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->next_block = 0;
+}
+
+/* llist_cont_calloc allocates zeroed memory for a container - from the arena if the container has one */
+static inline void *llist_cont_calloc(struct llist_container *cont, size_t size) {
+    if(cont->arena)
+        return llist_arena_alloc(cont->arena, size);
+    return calloc(1, size);
+}
+
+/* llist_cont_calloc_aligned allocates zeroed memory aligned to align for a container - from the arena if the
+ container has one */
+static inline void *llist_cont_calloc_aligned(struct llist_container *cont, size_t size, size_t align) {
+    if(cont->arena)
+        return llist_arena_alloc_aligned(cont->arena, size, align);
+    size = (size + align - 1) & ~(align - 1);
+    void *ptr = aligned_alloc(align, size);
+    if(ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+/* llist_node_stride returns the bytes a node takes up with inline_size bytes of inline payload room after it,
+ rounded up so the next node starts LLIST_NODE_ALIGN aligned */
+static inline size_t llist_node_stride(size_t inline_size) {
+    return (sizeof(struct llist) + inline_size + LLIST_NODE_ALIGN - 1) & ~(size_t)(LLIST_NODE_ALIGN - 1);
+}
+
+/* llist_cont_free frees memory from llist_cont_calloc - arena memory is left alone until the arena is released */
+static inline void llist_cont_free(struct llist_container *cont, void *ptr) {
+    if(!cont->arena)
+        free(ptr);
+}
+
+/* llist_data_owned returns true if the data a node points at was allocated separately and is the container's to
+ free when asked to - not arena memory, and not copied inline into the node */
+static inline bool llist_data_owned(struct llist_container *cont, struct llist *node) {
+    if(!node->data)
+        return false;
+    if(cont->inline_size && node->data == llist_node_inline(node))
+        return false;
+    return !(cont->arena && llist_arena_owns(cont->arena, node->data));
+}
+
+#ifdef USE_NODE_POOL
+/* llist_pool_recycle moves every node in a limbo list onto the free list.  The caller must hold the container lock */
+static void llist_pool_recycle(struct llist_pool *pool, size_t bucket) {
+    struct llist *node;
+    while((node = pool->limbo[bucket])) {
+        pool->limbo[bucket] = node->prev;
+        node->next = pool->free_list;
+        pool->free_list = node;
+    }
+}
+
+/* llist_pool_reclaim moves deleted nodes that no reader can still be looking at - those deleted two or more epochs
+ ago - onto the free list, nudging the epoch along first.  The caller must hold the container lock */
+static void llist_pool_reclaim(struct llist_pool *pool) {
+    bool pending = false;
+    for(size_t i = 0; i < LLIST_POOL_LIMBO; i++)
+        pending |= pool->limbo[i] != NULL;
+    if(!pending)
+        return;
+    llist_epoch_try_advance();
+    uint64_t epoch = llist_epoch_current();
+    for(size_t i = 0; i < LLIST_POOL_LIMBO; i++) {
+        if(pool->limbo[i] && pool->limbo_epoch[i] + 2 <= epoch)
+            llist_pool_recycle(pool, i);
+    }
+}
+
+/* llist_pool_slab_alloc allocates a slab of n_nodes nodes, aligned so that every node in it starts LLIST_NODE_ALIGN
+ aligned.  The caller must hold the container lock */
+static struct llist_slab *llist_pool_slab_alloc(struct llist_pool *pool, size_t n_nodes) {
+    size_t align = _Alignof(struct llist_slab);
+    size_t size = (sizeof(struct llist_slab) + n_nodes * pool->node_size + align - 1) & ~(align - 1);
+    if(pool->arena)
+        return llist_arena_alloc_aligned(pool->arena, size, align);
+    return aligned_alloc(align, size);
+}
+
+/* llist_pool_get pops a node off the pool free list, or carves a new one out of the current slab.
+ The returned node is zeroed.  The caller must hold the container lock */
+static struct llist *llist_pool_get(struct llist_pool *pool) {
+    if(!pool->free_list)
+        llist_pool_reclaim(pool);
+    struct llist *node = pool->free_list;
+    if(node) {
+        pool->free_list = node->next;
+        memset(node, 0, sizeof(struct llist));
+        return node;
+    }
+    if(!pool->slabs || pool->slabs->used == pool->slabs->n_nodes) {
+        if(pool->next_slab == 0)
+            pool->next_slab = LLIST_POOL_MIN_SLAB;
+        struct llist_slab *slab = llist_pool_slab_alloc(pool, pool->next_slab);
+        if(!slab)
+            return NULL;
+        slab->n_nodes = pool->next_slab;
+        slab->used = 0;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        if(pool->next_slab < LLIST_POOL_MAX_SLAB)
+            pool->next_slab *= 2;
+    }
+    // Nodes are node_size apart rather than sizeof(struct llist) so each one has its inline payload room after it
+    node = (struct llist *)((char *)pool->slabs->nodes + pool->slabs->used++ * pool->node_size);
+    memset(node, 0, sizeof(struct llist));
+    return node;
+}
+
+/* llist_pool_put returns a deleted node to the pool.  It goes into limbo for the current epoch rather than straight
+ onto the free list, and keeps its next pointer and data until it is reused, so a reader that found it before it
+ was deleted can carry on using it.  The caller must hold the container lock */
+static inline void llist_pool_put(struct llist_pool *pool, struct llist *node) {
+    uint64_t epoch = llist_epoch_stamp();
+    size_t bucket = epoch % LLIST_POOL_LIMBO;
+    if(pool->limbo_epoch[bucket] != epoch) {
+        // Anything still in this list was deleted at least LLIST_POOL_LIMBO epochs ago, so it is safe to reuse
+        llist_pool_recycle(pool, bucket);
+        pool->limbo_epoch[bucket] = epoch;
+    }
+    node->prev = pool->limbo[bucket];
+    pool->limbo[bucket] = node;
+}
+
+/* llist_pool_scan moves every node waiting in a hazard pointer container's retired list that no hazard pointer
+ protects onto the free list.  The caller must hold the container lock */
+static void llist_pool_scan(struct llist_pool *pool) {
+    struct llist_hazard_set set;
+    struct llist *node = pool->hazard_retired, *prev;
+    if(llist_hazard_snapshot(&set) < 0)
+        return;
+    pool->hazard_retired = NULL;
+    pool->n_hazard_retired = 0;
+    for(; node; node = prev) {
+        prev = node->prev;
+        if(llist_hazard_protected(&set, node)) {
+            node->prev = pool->hazard_retired;
+            pool->hazard_retired = node;
+            pool->n_hazard_retired++;
+        } else {
+            node->next = pool->free_list;
+            pool->free_list = node;
+        }
+    }
+    free(set.hazards);
+}
+
+/* llist_pool_put_hazard returns a node deleted from a hazard pointer container to the pool.  It waits on the
+ retired list, untouched apart from its prev pointer, until a scan finds no hazard pointer protecting it.  Scans run
+ once llist_hazard_threshold nodes are waiting, which bounds how many deleted nodes can be held back however long
+ a reader stalls.  The caller must hold the container lock */
+static inline void llist_pool_put_hazard(struct llist_pool *pool, struct llist *node) {
+    node->prev = pool->hazard_retired;
+    pool->hazard_retired = node;
+    if(++pool->n_hazard_retired >= llist_hazard_threshold())
+        llist_pool_scan(pool);
+}
+
+#endif /* USE_NODE_POOL */
+
+/* llist_pool_release frees every slab owned by the pool in one pass - any nodes still in use are gone after this.
+ Slabs carved out of an arena are left for the arena to release */
+static void llist_pool_release(struct llist_pool *pool) {
+    struct llist_slab *slab = pool->arena ? NULL : pool->slabs, *next;
+    while(slab) {
+        next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    memset(pool->limbo, 0, sizeof(pool->limbo));
+    pool->hazard_retired = NULL;
+    pool->n_hazard_retired = 0;
+    pool->next_slab = 0;
+}
+
+/* llist_node_new allocates a node for a container, from the container pool if we are using one.
+ The caller must hold the container lock */
+static inline struct llist *llist_node_new(struct llist_container *cont, void *data, size_t d_size) {
+#ifdef USE_NODE_POOL
+    struct llist *new = llist_pool_get(&cont->pool);
+    if(!new)
+        return NULL;
+    llist_set_node_data(new, data, d_size);
+    return new;
+#else
+    struct llist *new = llist_cont_calloc_aligned(cont, cont->pool.node_size, LLIST_NODE_ALIGN);
+    if(!new)
+        return NULL;
+    llist_set_node_data(new, data, d_size);
+    return new;
+#endif
+}
+
+/* llist_node_free hands a node allocated by llist_node_new back.  Nothing is freed or reused until readers that
+ might still hold the node have left their epoch critical sections, or for hazard pointer containers until no
+ hazard pointer protects it.  The caller must hold the container lock */
+static inline void llist_node_free(struct llist_container *cont, struct llist *node) {
+#ifdef USE_NODE_POOL
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD)
+        llist_pool_put_hazard(&cont->pool, node);
+    else
+        llist_pool_put(&cont->pool, node);
+#else
+    if(cont->arena)
+        return;
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD)
+        llist_hazard_retire(node, node, free);
+    else
+        llist_epoch_retire(node, free);
+#endif
+}
+
+/* llist_pool_new creates a new linked list entry with data, allocated the same way the container allocates its own
+ nodes - from its slab pool when USE_NODE_POOL is defined.  The node must only be linked into cont, since deleting it
+ hands it back to cont's pool */
+struct llist *llist_pool_new(struct llist_container *cont, void *data, size_t d_size) {
+    if(!cont)
+        return NULL;
+    LOCK(cont);
+    struct llist *new = llist_node_new(cont, data, d_size);
+    UNLOCK(cont);
+    return new;
+}
+
+/* container_new creates a new linked list container and the initial first linked list entry.  Containers are cache
+ line aligned so each group of fields in struct llist_container gets its own lines */
 struct llist_container *container_new(void) {
-    struct llist_container *new = calloc(1, sizeof(struct llist_container));
+    struct llist_container *new = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_container));
     if(!new)
         return NULL;
-    for(int i = 0; i < HASHMAP_SIZE; i++) {
-        new->h_map[i] = NULL;
-    }
+    memset(new, 0, sizeof(struct llist_container));
+    new->pool.node_size = llist_node_stride(0);
 #ifdef USE_LOCK
     atomic_store(&new->use_lock, true);
 #else
@@ -34,21 +318,246 @@ struct llist_container *container_new(void) {
     return new;
 }
 
+/* llist_index_wanted returns true if node belongs in the container hash index - the container keeps its index up to
+ date on every insert and the node has data to index.  The caller must hold the container lock */
+static inline bool llist_index_wanted(struct llist_container *cont, struct llist *node) {
+    return cont->indexed && node->data && node->data_size != 0;
+}
+
+/* llist_index_add adds node to the container hash index if the container keeps its index up to date on every
+ insert.  The caller must hold the container lock, the index stripe lock is taken inside it */
+static inline int llist_index_add(struct llist_container *cont, struct llist *node) {
+    if(!llist_index_wanted(cont, node))
+        return 0;
+    uint64_t hash = llist_node_hash(node);
+    hash_map_lock(cont->h_map, hash);
+    int ret = hash_map_insert(cont->h_map, node, hash);
+    hash_map_unlock(cont->h_map, hash);
+    return ret;
+}
+
+/* llist_index_remove removes node from the container hash index if it is indexed there.
+ The caller must hold the container lock, the index stripe lock is taken inside it */
+static inline void llist_index_remove(struct llist_container *cont, struct llist *node) {
+    if(!cont->h_map || !node->data || node->data_size == 0)
+        return;
+    uint64_t hash = llist_node_hash(node);
+    hash_map_lock(cont->h_map, hash);
+    hash_map_erase(cont->h_map, node, hash);
+    hash_map_unlock(cont->h_map, hash);
+}
+
+/* llist_index_reserve takes the index stripe lock for a node that is about to be linked in and makes room for it,
+ so that indexing it once it is linked can't fail.  On success the stripe lock is left held for
+ llist_index_add_unlock.  The caller must hold the container lock.  Returns -1 on failure with nothing held */
+static inline int llist_index_reserve(struct llist_container *cont, struct llist *node) {
+    if(!llist_index_wanted(cont, node))
+        return 0;
+    uint64_t hash = llist_node_hash(node);
+    hash_map_lock(cont->h_map, hash);
+    if(hash_map_reserve(cont->h_map, hash) < 0) {
+        hash_map_unlock(cont->h_map, hash);
+        return -1;
+    }
+    return 0;
+}
+
+/* llist_index_unreserve lets go of the stripe lock taken by llist_index_reserve for a node that won't be linked in
+ after all */
+static inline void llist_index_unreserve(struct llist_container *cont, struct llist *node) {
+    if(llist_index_wanted(cont, node))
+        hash_map_unlock(cont->h_map, llist_node_hash(node));
+}
+
+/* llist_index_add_unlock releases the container lock and then indexes node, after llist_index_reserve.  Other
+ writers can get at the list while the index is being updated, and only wait on us if their entries land in the
+ same stripe - the stripe lock we hold also keeps a delete of node from reaching the index before we do */
+static inline void llist_index_add_unlock(struct llist_container *cont, struct llist *node) {
+    if(!llist_index_wanted(cont, node)) {
+        UNLOCK(cont);
+        return;
+    }
+    struct llist_map *map = cont->h_map;
+    uint64_t hash = llist_node_hash(node);
+    UNLOCK(cont);
+    // Can't fail - llist_index_reserve made room under the stripe lock we still hold
+    hash_map_insert(map, node, hash);
+    hash_map_unlock(map, hash);
+    // Growing the index retires the tables it replaces, and inserts never enter a critical section to free them
+    llist_epoch_poll();
+}
+
+/* llist_index_rebuild builds a fresh hash index of the list, indexing every entry that has data under the full
+ 64 bit hash of that data, and publishes it as the container's index.  The new index is built off to the side,
+ sized to the list, and then published in one go - on later calls its tables are swapped into the existing index,
+ so lookups carry on against the previous tables while the rebuild runs and never see a partly built one.  The
+ caller must hold the container lock.  Returns the index, or NULL on failure */
+static struct llist_map *llist_index_rebuild(struct llist_container *cont) {
+    struct llist_map *fresh = hash_map_new(cont->list_entries);
+    if(!fresh)
+        return NULL;
+    // Writers update the index after letting go of the container lock, so wait for any of those to finish
+    if(cont->h_map)
+        hash_map_lock_all(cont->h_map);
+    for(struct llist *node = cont->head; node; node = node->next) {
+        if(node->data_size == 0 || !node->data)
+            continue;
+        if(hash_map_insert(fresh, node, llist_node_hash(node)) < 0) {
+            hash_map_free(fresh);
+            if(cont->h_map)
+                hash_map_unlock_all(cont->h_map);
+            return NULL;
+        }
+    }
+    if(!cont->h_map) {
+        cont->h_map = fresh;
+    } else {
+        hash_map_replace(cont->h_map, fresh);
+        hash_map_unlock_all(cont->h_map);
+    }
+    return cont->h_map;
+}
+
+/* container_new_indexed creates an empty container that keeps its hash index up to date on every insert and delete,
+ so hash_map_create never has to be called to rebuild it */
+struct llist_container *container_new_indexed(void) {
+    struct llist_container *new = container_new();
+    if(!new)
+        return NULL;
+    if(container_set_indexed(new, true) < 0) {
+        free(new);
+        return NULL;
+    }
+    return new;
+}
+
+/* container_set_indexed turns incremental index maintenance on or off for a container.  Turning it on builds a
+ fresh index of the entries already in the list, and lookups go through the index from then on.  Turning it off
+ sends lookups back to walking the list and leaves the index to go stale - it is rebuilt if indexing is turned
+ back on */
+int container_set_indexed(struct llist_container *cont, bool indexed) {
+    if(!cont)
+        return -1;
+    // We don't create hash maps of rings
+    if(indexed && cont->is_ring)
+        return -1;
+    LOCK(cont);
+    // Whatever index there is may have missed changes made while the container wasn't indexed, so build a fresh one
+    // under the lock before lookups are pointed at it
+    if(indexed && !atomic_load_explicit(&cont->indexed, memory_order_relaxed) && !llist_index_rebuild(cont)) {
+        UNLOCK(cont);
+        return -1;
+    }
+    // Release pairs with the acquire in llist_lookup_map, so a lookup that sees the flag sees the finished index
+    atomic_store_explicit(&cont->indexed, indexed, memory_order_release);
+    UNLOCK(cont);
+    return 0;
+}
+
+/* container_set_lock_type selects how threads wait for the container lock.  LLIST_LOCK_ADAPTIVE suits containers
+ where the lock is held for long stretches (hash_map_create holds it for the whole build) since waiters park rather
+ than spin.  LLIST_LOCK_RW lets lookups and traversals share the lock.  This must be called while no other thread
+ is using the container */
+int container_set_lock_type(struct llist_container *cont, enum llist_lock_type lock_type) {
+    if(!cont || atomic_load(&cont->locked) != LLIST_LOCK_FREE)
+        return -1;
+    if(lock_type == LLIST_LOCK_RW && !cont->rw) {
+        cont->rw = llist_rwlock_new();
+        if(!cont->rw)
+            return -1;
+    }
+    cont->lock_type = lock_type;
+    return 0;
+}
+
+/* container_set_reclaim selects how deleted nodes are kept from readers that may still be using them.
+ LLIST_RECLAIM_HAZARD bounds the memory a stalled reader can hold back, at the price of llist_find publishing a
+ hazard pointer to every entry it returns.  This must be called while no other thread is using the container */
+int container_set_reclaim(struct llist_container *cont, enum llist_reclaim reclaim) {
+    if(!cont || atomic_load(&cont->locked) != LLIST_LOCK_FREE)
+        return -1;
+    cont->reclaim = reclaim;
+    return 0;
+}
+
+/* container_set_inline_size sets aside inline_size bytes after every node, and from then on llist_insert_data_copy
+ stores payloads up to that size there instead of allocating them, so scans read them straight out of the node.
+ Nodes are spaced further apart in their slabs to make room, so this must be called on an empty container before
+ its first node is allocated, and while no other thread is using it */
+int container_set_inline_size(struct llist_container *cont, size_t inline_size) {
+    if(!cont || inline_size > LLIST_INLINE_MAX || atomic_load(&cont->locked) != LLIST_LOCK_FREE)
+        return -1;
+    if(cont->pool.slabs || cont->head || cont->list) {
+        printf("Inline payload size can only be set before the container has any nodes\n");
+        return -1;
+    }
+    // Keep every node, and so every inline payload, 8 byte aligned
+    cont->inline_size = (inline_size + 7) & ~(size_t)7;
+    cont->pool.node_size = llist_node_stride(cont->inline_size);
+    return 0;
+}
+
+/* container_new_arena creates an empty container whose nodes and copied data are all
+ bump allocated from an arena, so container_free releases everything with a handful of munmap calls */
+struct llist_container *container_new_arena(void) {
+    struct llist_container *new = container_new();
+    if(!new)
+        return NULL;
+    new->arena = calloc(1, sizeof(struct llist_arena));
+    if(!new->arena) {
+        free(new);
+        return NULL;
+    }
+    new->pool.arena = new->arena;
+    return new;
+}
+
+/* container_free tears down a container along with every node and the hash map it owns.  If free_data is true
+ the data pointer in each node is freed as well.  With USE_NODE_POOL the nodes go away with their slabs so
+ the list is only walked when data has to be freed */
+void container_free(struct llist_container *cont, bool free_data) {
+    struct llist *node, *next;
+    if(!cont)
+        return;
+    LOCK(cont);
+#ifdef USE_NODE_POOL
+    if(free_data) {
+#endif
+        node = cont->head;
+        for(size_t i = 0; node && (!cont->is_ring || i < cont->list_entries); i++) {
+            next = node->next;
+            if(free_data && llist_data_owned(cont, node))
+                free(node->data);
+#ifndef USE_NODE_POOL
+            llist_cont_free(cont, node);
+#endif
+            node = next;
+        }
+#ifdef USE_NODE_POOL
+    }
+    llist_pool_release(&cont->pool);
+#endif
+    if(cont->arena) {
+        llist_arena_release(cont->arena);
+        free(cont->arena);
+    }
+    hash_map_free(cont->h_map);
+    UNLOCK(cont);
+    llist_rwlock_free(cont->rw);
+    free(cont);
+}
+
 /* container_new_ring creates a new container containing a ring - where the the linked list is circular in nature*/
 struct llist_container *container_new_ring(int ring_entries) {
-    struct llist_container *new = calloc(1, sizeof(struct llist_container));
+    struct llist_container *new = container_new();
     struct llist *current = NULL;
     if(!new)
         return NULL;
-#ifdef USE_LOCK
-    atomic_store(&new->use_lock, true);
-#else
-    atomic_store(&new->use_lock, false);
-#endif
+    new->is_ring = true;
     LOCK(new);
     for(int i = 0; i < ring_entries; i++) {
         if(i == 0) {
-            current = new->head = new->list = llist_new(NULL, 0);
+            current = new->head = new->list = llist_node_new(new, NULL, 0);
             if(!new->list) {
                 printf("Failed adding initial ring entry - bailing\n");
                 UNLOCK(new);
@@ -58,7 +567,7 @@ struct llist_container *container_new_ring(int ring_entries) {
             continue;
         }
         current = new->list;
-        new->list->next = llist_new(NULL, 0);
+        new->list->next = llist_node_new(new, NULL, 0);
         if(!new->list->next) {
             printf("Failed creating ring entry %d, bailing\n", i);
             UNLOCK(new);
@@ -77,23 +586,19 @@ struct llist_container *container_new_ring(int ring_entries) {
 
 /* container_new_list creates a container with a doubly linked list containing list_entries entries in the list */
 struct llist_container *container_new_list(int list_entries) {
-    struct llist_container *new = calloc(1, sizeof(struct llist_container));
+    struct llist_container *new = container_new();
     struct llist *current = NULL;
     if(!new)
         return NULL;
-#ifdef USE_LOCK
-    atomic_store(&new->use_lock, true);
-#else
-    atomic_store(&new->use_lock, false);
-#endif
     
     LOCK(new);
     for(int i = 0; i < list_entries; i++) {
         if(i == 0) {
-            current = new->head = new->list = llist_new(NULL, 0);
+            current = new->head = new->list = llist_node_new(new, NULL, 0);
             if(!new->list) {
                 printf("Failed adding initial ring entry - bailing\n");
                 UNLOCK(new);
+                llist_pool_release(&new->pool);
                 free(new);
                 return NULL;
             }
@@ -101,16 +606,19 @@ struct llist_container *container_new_list(int list_entries) {
             continue;
         }
         current = new->list;
-        new->list->next = llist_new(NULL, 0);
+        new->list->next = llist_node_new(new, NULL, 0);
         if(!new->list->next) {
             printf("Failed allocating for next list entry, freeing up and bailing\n");
+#ifndef USE_NODE_POOL
             new->list = new->head;
             while(new->list->next) {
                 new->list = new->list->next;
                 free(new->list->prev);
             }
             free(new->list);
+#endif
             UNLOCK(new);
+            llist_pool_release(&new->pool);
             free(new);
             return NULL;
         }
@@ -126,8 +634,43 @@ struct llist_container *container_new_list(int list_entries) {
     return new;
 }
 
+/* llist_node_set_data points node at new data and reindexes it.  Lookups through the index of an indexed container
+ read a node's data, size and hash without the lock, so there the node isn't rewritten in place - a reader could
+ pair the new pointer with the old size and compare past the end of a buffer.  Instead a fresh node holding the new
+ data takes its place in the list, including as head, tail or list, and the old node is retired the same way a
+ deleted one is, so a reader that already found it sees its old data whole until it is done.  Anyone holding on to
+ the old node pointer must look the entry up again.  The caller must hold the container lock.  Returns -1 on
+ failure, leaving the node linked but out of the index if only the reindexing failed */
+static int llist_node_set_data(struct llist_container *cont, struct llist *node, void *data, size_t d_size) {
+    if(!atomic_load_explicit(&cont->indexed, memory_order_relaxed)) {
+        // Every reader of an unindexed container holds the lock, so nobody can see the node half rewritten
+        llist_index_remove(cont, node);
+        llist_set_node_data(node, data, d_size);
+        return 0;
+    }
+    struct llist *new = llist_node_new(cont, data, d_size);
+    if(!new)
+        return -1;
+    llist_index_remove(cont, node);
+    new->prev = node->prev;
+    new->next = node->next;
+    if(new->prev)
+        new->prev->next = new;
+    if(new->next)
+        new->next->prev = new;
+    if(cont->head == node)
+        cont->head = new;
+    if(cont->tail == node)
+        cont->tail = new;
+    if(cont->list == node)
+        cont->list = new;
+    llist_node_free(cont, node);
+    return llist_index_add(cont, new);
+}
+
 /* list_set_from_array creates a linked list from an array.
- NOTE: This does not copy data from the array - it merely points to array entries */
+ NOTE: This does not copy data from the array - it merely points to array entries.  On indexed containers each
+ entry set is replaced by a new node holding the data - see llist_node_set_data */
 int list_set_from_array(struct llist_container *cont, void *array_head, size_t entry_size, size_t n_entries) {
     if(!cont)
         return -1;
@@ -137,21 +680,27 @@ int list_set_from_array(struct llist_container *cont, void *array_head, size_t e
             printf("Warning: array entries exceeds ring entries - early array entries will be overwritten on the ring\n");
         } else {
             printf("Insufficient space in list for number of fill entries\n");
+            UNLOCK(cont);
             return -1;
         }
     }
     for(int i = 0; i < n_entries; i++) {
-        cont->list->data = array_head;
-        cont->list->data_size = entry_size;
+        if(llist_node_set_data(cont, cont->list, array_head, entry_size) < 0) {
+            UNLOCK(cont);
+            return -1;
+        }
         cont->list = cont->list->next;
         array_head += entry_size;
     }
     UNLOCK(cont);
+    // Free the nodes and tables retired on indexed containers now we aren't holding the lock
+    llist_epoch_poll();
     return 0;
 }
 
 
-/* llist_set_data sets the data pointer in the last entry of the list defined inside the container */
+/* llist_set_data sets the data pointer in the last entry of the list defined inside the container.  On indexed
+ containers the last entry is replaced by a new node holding the data - see llist_node_set_data */
 int llist_set_data(struct llist_container *cont, void *data, size_t d_size) {
     // Container doesnt exist - bail
     if(!cont)
@@ -163,9 +712,12 @@ int llist_set_data(struct llist_container *cont, void *data, size_t d_size) {
         UNLOCK(cont);
         return -1;
     }
-    cont->tail->data = data;
-    cont->tail->data_size = d_size;
+    if(llist_node_set_data(cont, cont->tail, data, d_size) < 0) {
+        UNLOCK(cont);
+        return -1;
+    }
     UNLOCK(cont);
+    llist_epoch_poll();
     return 0;
 }
 
@@ -173,25 +725,35 @@ int llist_set_data(struct llist_container *cont, void *data, size_t d_size) {
 int llist_add_head_data(struct llist_container *cont, void *data, size_t d_size) {
     if(!cont)
         return -1;
-    struct llist *new_entry = llist_new(data, d_size);
-    if(!new_entry)
-        return -1;
     LOCK(cont);
+    struct llist *new_entry = llist_node_new(cont, data, d_size);
+    if(!new_entry) {
+        UNLOCK(cont);
+        return -1;
+    }
+    if(llist_index_reserve(cont, new_entry) < 0) {
+        llist_node_free(cont, new_entry);
+        UNLOCK(cont);
+        return -1;
+    }
     if(!cont->head) {
         if(cont->tail) {
             printf("Something broke, no head entry with existing tail entry\n");
-            free(new_entry);
+            llist_index_unreserve(cont, new_entry);
+            llist_node_free(cont, new_entry);
             UNLOCK(cont);
             return -1;
         }
         cont->head = cont->tail = cont->list = new_entry;
-        UNLOCK(cont);
+        cont->list_entries++;
+        llist_index_add_unlock(cont, new_entry);
         return 0;
     }
     new_entry->next = cont->head;
     cont->head->prev = new_entry;
     cont->head = new_entry;
-    UNLOCK(cont);
+    cont->list_entries++;
+    llist_index_add_unlock(cont, new_entry);
     return 0;
 }
 
@@ -199,60 +761,86 @@ int llist_add_head_data(struct llist_container *cont, void *data, size_t d_size)
 int llist_add_tail_data(struct llist_container *cont, void *data, size_t d_size) {
     if(!cont)
         return -1;
-    struct llist *new_entry = llist_new(data, d_size);
-    if(!new_entry)
-        return -1;
     LOCK(cont);
+    struct llist *new_entry = llist_node_new(cont, data, d_size);
+    if(!new_entry) {
+        UNLOCK(cont);
+        return -1;
+    }
+    if(llist_index_reserve(cont, new_entry) < 0) {
+        llist_node_free(cont, new_entry);
+        UNLOCK(cont);
+        return -1;
+    }
     if(!cont->tail) {
         if(cont->head) {
             printf("Something broke, no tail entry with existing head entry\n");
-            free(new_entry);
+            llist_index_unreserve(cont, new_entry);
+            llist_node_free(cont, new_entry);
             UNLOCK(cont);
             return -1;
         }
         cont->head = cont->tail = cont->list = new_entry;
-        UNLOCK(cont);
+        cont->list_entries++;
+        llist_index_add_unlock(cont, new_entry);
         return 0;
     }
     cont->tail->next = new_entry;
     new_entry->prev = cont->tail;
     cont->tail = new_entry;
-    UNLOCK(cont);
+    cont->list_entries++;
+    llist_index_add_unlock(cont, new_entry);
     return 0;
 }
 
-/* llist_add_current_data inserts a new linked list entry at the current list pointer */
+/* llist_add_current_data inserts a new linked list entry at the current list pointer - the new entry goes in just
+ before the current one and becomes the current entry, so the entry that was current stays linked in after it */
 int llist_add_current_data(struct llist_container *cont, void *data, size_t d_size) {
     if(!cont)
         return -1;
     // Deal with the case of there being no current list entry in the container
-    struct llist *new_entry = llist_new(data, d_size);
     LOCK(cont);
-    if(!cont->list) {
-        if(!cont->is_ring) {
-            if(cont->tail || cont->head) {
-                // Something broke - we have a list entry but no head or tail and this isn't a ring
-                printf("Something broke, current list entry with no list head or tail and not a ring structure\n");
-                free(new_entry);
-                UNLOCK(cont);
-                return -1;
-            }
-        }
-        // This is a ring with zero entries, head and tail don't matter so just set the new entry as the list and get out
-        cont->list = new_entry;
+    struct llist *new_entry = llist_node_new(cont, data, d_size);
+    if(!new_entry) {
         UNLOCK(cont);
-        return 0;
+        return -1;
     }
-    if(cont->list->prev) {
-        new_entry->prev = cont->list->prev;
-        cont->list->prev->next = new_entry;
+    if(llist_index_reserve(cont, new_entry) < 0) {
+        llist_node_free(cont, new_entry);
+        UNLOCK(cont);
+        return -1;
     }
-    if(cont->list->next) {
-        new_entry->next = cont->list->next;
-        cont->list->next->prev = new_entry;
+    if(!cont->list) {
+        if(cont->tail || cont->head) {
+            // Something broke - we have a head or tail but no current list entry
+            printf("Something broke, list head or tail with no current list entry\n");
+            llist_index_unreserve(cont, new_entry);
+            llist_node_free(cont, new_entry);
+            UNLOCK(cont);
+            return -1;
+        }
+        // The list is empty, so the new entry is all of it - a ring of one entry points back at itself
+        if(cont->is_ring)
+            new_entry->next = new_entry->prev = new_entry;
+        else
+            cont->tail = new_entry;
+        cont->head = cont->list = new_entry;
+        cont->list_entries++;
+        llist_index_add_unlock(cont, new_entry);
+        return 0;
     }
+    struct llist *current = cont->list;
+    new_entry->prev = current->prev;
+    new_entry->next = current;
+    if(current->prev)
+        current->prev->next = new_entry;
+    current->prev = new_entry;
+    // On a ring the head just marks where the ring was started, so it stays put
+    if(!cont->is_ring && cont->head == current)
+        cont->head = new_entry;
     cont->list = new_entry;
-    UNLOCK(cont);
+    cont->list_entries++;
+    llist_index_add_unlock(cont, new_entry);
     return 0;
 }
 
@@ -324,235 +912,357 @@ int llist_insert_between(struct llist_container *cont, struct llist *first, stru
         printf("Specified nodes are non-adjacent\n");
         return -1;
     }
-    struct llist *new = llist_new(data, d_size);
-    if(!new)
+    LOCK(cont);
+    struct llist *new = llist_node_new(cont, data, d_size);
+    if(!new) {
+        UNLOCK(cont);
         return -1;
+    }
+    if(llist_index_reserve(cont, new) < 0) {
+        llist_node_free(cont, new);
+        UNLOCK(cont);
+        return -1;
+    }
     new->prev = first;
     new->next = second;
-    LOCK(cont);
     first->next = new;
     second->prev = new;
     cont->list_entries++;
-    UNLOCK(cont);
+    llist_index_add_unlock(cont, new);
     return 0;
 }
 
-/* llist_free_data will free up the data pointer if do_free is true */
-static inline void llist_free_data(bool do_free, struct llist *node) {
-    if(do_free && node->data)
-        free(node->data);
+/* llist_free_data will free up the data pointer if do_free is true, once no reader can still be looking at it -
+ data copied into a container arena is left for the arena to release, and data stored inline goes with the node */
+static inline void llist_free_data(struct llist_container *cont, bool do_free, struct llist *node) {
+    if(!do_free || !llist_data_owned(cont, node))
+        return;
+    // Readers protect the node rather than its data, so the node is what the data waits on
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD)
+        llist_hazard_retire(node->data, node, free);
+    else
+        llist_epoch_retire(node->data, free);
+}
+
+/* llist_delete_unlock unlinks node from the list, retires it and its data, and releases the container lock, taking
+ the node out of the index after the lock is released under just the index stripe lock.  The caller must be inside
+ an epoch critical section and hold the container lock - and the stripe lock for the node's hash as well if
+ stripe_held is set, as llist_delete_data does */
+static void llist_delete_unlock(struct llist_container *cont, struct llist *node, bool do_free, bool stripe_held) {
+    struct llist_map *map = cont->h_map;
+    bool indexed = map && node->data && node->data_size != 0;
+    uint64_t hash = indexed ? llist_node_hash(node) : 0;
+    bool hazard = cont->reclaim == LLIST_RECLAIM_HAZARD;
+    cont->list_entries--;
+    if(cont->head == node) {
+        cont->head = cont->head->next;
+        if(cont->head)
+            cont->head->prev = NULL;
+        else
+            cont->tail = NULL;
+    } else if(cont->tail == node) {
+        cont->tail = cont->tail->prev;
+        if(cont->tail)
+            cont->tail->next = NULL;
+        else
+            cont->head = NULL;
+    } else {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+    // Epoch containers can retire the node straight away, it can't be reused while we are in our critical section
+    if(!hazard) {
+        llist_free_data(cont, do_free, node);
+        llist_node_free(cont, node);
+    }
+    if(indexed && !stripe_held)
+        hash_map_lock(map, hash);
+    UNLOCK(cont);
+    if(indexed) {
+        hash_map_erase(map, node, hash);
+        hash_map_unlock(map, hash);
+    }
+    // Hazard pointer readers publish what they find in the index under the read lock, so the node is only retired
+    // under the lock once it is out of the index - every reader that found it has published it by then
+    if(hazard) {
+        LOCK(cont);
+        llist_free_data(cont, do_free, node);
+        llist_node_free(cont, node);
+        UNLOCK(cont);
+    }
 }
 
 /* llist_delete_node deletes a node in the linked list - if free_data is true it will also free up the data entry */
 /* This function has been modified to also delete any entries in an existent hash map*/
+/* The node and its data are retired rather than freed, so a reader inside an epoch critical section that found
+ the node before it was deleted can keep using it until it leaves the critical section.  The node is taken out of
+ the index after the container lock is released, under just the index stripe lock */
 int llist_delete_node(struct llist_container *cont, struct llist *node, bool do_free) {
     if(!cont)
         return -1;
     if(!node)
         return -1;
+    // Keeps the node from being reused until we have taken it out of the index below
+    if(llist_epoch_enter() < 0)
+        return -1;
     LOCK(cont);
-    if(node->data && node->data_size != 0) {
-        // Hash the data
-        uint64_t hash = XXH3_64bits(node->data, node->data_size);
-        // if there is a hash map entry for this - we need to get rid of it
-        if(cont->h_map[hash] && cont->h_map[hash]->hash == hash) {
-            // There is no collision on the hash map entry, so we can just free that point in the map
-            if(!cont->h_map[hash]->collision) {
-                free(cont->h_map[hash]);
-                cont->h_map[hash] = NULL;
-            } else {
-                // Data matches the hash map entry
-                if(llist_compare_entries(cont->h_map[hash]->entry, node)) {
-                    // Move the first collision list entry to the main hash map
-                    cont->h_map[hash]->entry = cont->h_map[hash]->collision->entry;
-                    // If there is a second collision free the first collision entry and make the second
-                    // entry the first collision entry
-                    if(cont->h_map[hash]->collision->next) {
-                        struct llist_collision *temp = cont->h_map[hash]->collision->next;
-                        free(cont->h_map[hash]->collision);
-                        cont->h_map[hash]->collision = temp;
-                    } else {
-                        free(cont->h_map[hash]->collision);
-                        cont->h_map[hash]->collision = NULL;
-                    }
-                } else {
-                    struct llist_collision *current, *previous = NULL;
-                    current = cont->h_map[hash]->collision;
-                    do {
-                        if(llist_compare_entries(current->entry, node)) {
-                            // There is a previous entry in the collision list
-                            if(previous) {
-                                previous->next = current->next;
-                                free(current);
-                                break;
-                            } else {
-                                previous = cont->h_map[hash]->collision;
-                                cont->h_map[hash]->collision = current->next;
-                                free(previous);
-                                break;
-                            }
-                        }
-                        previous = current;
-                        current = current->next;
-                    } while(current);
-                }
-            }
-            
-        }
-    }
-    if(cont->head == node) {
-        if(cont->head->next) {
-            cont->head = cont->head->next;
-            llist_free_data(do_free, node);
-            free(node);
-            UNLOCK(cont);
-            return 0;
-        }
-        cont->head = NULL;
-        cont->tail = NULL;
-        llist_free_data(do_free, node);
-        free(node);
-        UNLOCK(cont);
-        return 0;
-    }
-    if(cont->tail == node) {
-        if(cont->tail->prev) {
-            cont->tail = cont->tail->prev;
-            llist_free_data(do_free, node);
-            free(node);
-            UNLOCK(cont);
-            return 0;
-        }
-        cont->head = NULL;
-        cont->tail = NULL;
-        llist_free_data(do_free, node);
-        free(node);
-        UNLOCK(cont);
-        return 0;
-    }
-    node->prev->next = node->next;
-    node->next->prev = node->prev;
-    llist_free_data(do_free, node);
-    free(node);
-    UNLOCK(cont);
+    llist_delete_unlock(cont, node, do_free, false);
+    // Leaving the critical section frees anything retired a couple of epochs ago, now we aren't holding up other
+    // threads
+    llist_epoch_exit();
     return 0;
 }
 
 /* llist_insert_data_copy inserts data at a specified node by copying it from source,
  node->data MUST be NULL when calling this.  Note - calling this means that you have to free up the data entries
-if you free up the linked list */
+if you free up the linked list.  Arena containers copy the data into the arena, which is released with the container.
+Data that fits in the container's inline size is copied into the node itself, so reading it back doesn't touch
+another cache line - it is released along with the node */
 int llist_insert_data_copy(struct llist_container *cont, struct llist *node, void *data, size_t d_size) {
+    void *copy;
     if(!cont || !node || node->data)
         return -1;
-    node->data = calloc(1, d_size);
-    if(!node->data)
+    LOCK(cont);
+    // Containers without inline room must never point data at the node itself, even for an empty payload - that is
+    // how llist_data_owned tells inline data from data it has to free
+    if(cont->inline_size && d_size <= cont->inline_size)
+        copy = llist_node_inline(node);
+    else
+        copy = llist_cont_calloc(cont, d_size);
+    if(!copy) {
+        UNLOCK(cont);
         return -1;
-    memcpy(node->data, data, d_size);
+    }
+    memcpy(copy, data, d_size);
+    llist_set_node_data(node, copy, d_size);
+    if(llist_index_add(cont, node) < 0) {
+        UNLOCK(cont);
+        return -1;
+    }
+    UNLOCK(cont);
     return 0;
 }
 
-/* llist_compare_entries compares the data between two linked list entries */
-static inline bool llist_compare_entries(struct llist *entry1, struct llist *entry2) {
-    return (entry1 && entry2 && (entry1->data_size == entry2->data_size) &&
-            !memcmp(entry1->data, entry2->data, entry1->data_size));
-}
-
-/* llist_create_hash_map creates a hash map of every entry in the list, utilising collision avoidance where necessary
-   This function returns a double pointer containing HASHMAP_SIZE entries, where unused entries in the array are set
-   to NULL */
-struct llist_map **hash_map_create(struct llist_container *cont) {
-    struct llist_map *h_map;
-    bool found = false;
+/* hash_map_create (re)builds the hash index of the list - see llist_index_rebuild.  Lookups only go through the
+ index of containers that keep it up to date on every insert and delete, see container_set_indexed - on any other
+ container the index is a snapshot that goes stale as soon as the list changes, only good for walking with
+ hash_map_next.  Returns the index, or NULL on failure */
+struct llist_map *hash_map_create(struct llist_container *cont) {
+    struct llist_map *map = NULL;
     if(!cont) {
         printf("Container not intialized\n");
         return NULL;
     }
     LOCK(cont);
     // We don't create hash maps of rings
-    if(cont->is_ring)
-        goto end_error;
-    if(!cont->head) {
-        printf("No linked list head\n");
-        goto end_error;
-    }
-    // reset the list pointer to the head of the list
-    cont->list = cont->head;
-    int entries = 0;
-    while(cont->list) {
-        found = false;
-        if(cont->list->data_size != 0 && cont->list->data) {
-            entries++;
-            uint64_t hash = XXH3_64bits(cont->list->data, cont->list->data_size)%HASHMAP_SIZE;
-            printf("Hashing linked list entry %d, hash was %llu\n", entries, hash);
-            h_map = cont->h_map[hash];
-            printf("h_map base at %p and h_map[%llu] at %p\n", cont->h_map, hash, h_map);
-            if(h_map) {
-                printf("We have a hash collision... deal with this, for now, not adding hash entry for this\n");
-                printf("Hash was %llu\n",hash);
-                if(llist_compare_entries(h_map->entry, cont->list)) {
-                    cont->list = cont->list->next;
-                    continue;
-                    // Duplicate data do nothing
-                } else {
-                    if(!h_map->collision) {
-                        h_map->collision = calloc(1, sizeof(struct llist_collision));
-                        if(!h_map->collision) {
-                            printf("Failed allocating for collision\n");
-                            return NULL;  // Probably need better error handling here
-                        }
-                        h_map->collision->entry = cont->list;
-                        h_map->collision->hash = hash;
-                        cont->list = cont->list->next;
-                        continue;
-                    } else {
-                        struct llist_collision *col_entry = h_map->collision;
-                        // Duplicate data found in the collision entry
-                        if(llist_compare_entries(col_entry->entry, cont->list)) {
-                            cont->list = cont->list->next;
-                            continue;
-                        }
-                        while(col_entry->next) {
-                            if(llist_compare_entries(col_entry->entry, cont->list)) {
-                                cont->list = cont->list->next;
-                                found = true;
-                                break;
-                            }
-                            col_entry = col_entry->next;
-                        }
-                        if(found) {
-                            cont->list = cont->list->next;
-                            continue;
-                        }
-                        col_entry->next = calloc(1, sizeof(struct llist_collision));
-                        if(!col_entry->next) {
-                            printf("Failed to allocate for next collision entry\n");
-                            goto end_error;
-                        }
-                        col_entry = col_entry->next;
-                        col_entry->entry = cont->list;
-                        cont->list = cont->list->next;
-                        continue;
-                    }
-                }
-            } else {
-                cont->h_map[hash] = calloc(1, sizeof(struct llist_map));
-                if(!cont->h_map[hash])
-                    goto end_error;
-                cont->h_map[hash]->entry = cont->list;
-                cont->h_map[hash]->hash = hash;
-                cont->list = cont->list->next;
-                continue;
-            }
-        }
-        cont->list = cont->list->next;
+    if(cont->is_ring) {
+        UNLOCK(cont);
+        return NULL;
     }
+    if(!cont->head)
+        printf("No linked list head\n");
+    else
+        map = llist_index_rebuild(cont);
     UNLOCK(cont);
-    return cont->h_map;
-end_error:
-    UNLOCK(cont);
+    // A rebuild retires the tables it replaces
+    llist_epoch_poll();
+    return map;
+}
+
+/* llist_key sets up a stack node to compare against list entries when looking up data */
+static inline struct llist llist_key(const void *data, size_t d_size, uint64_t hash) {
+    struct llist key = { .data = (void *)data, .data_size = d_size };
+#ifdef USE_HASH_CACHE
+    key.hash = hash;
+#endif
+    return key;
+}
+
+/* llist_match_data is the hash_map_match_fn used for lookups - it compares a list entry with the data being looked up */
+static bool llist_match_data(void *entry, uint64_t hash, const void *data, size_t d_size) {
+    struct llist key = llist_key(data, d_size, hash);
+    return llist_compare_entries(entry, &key);
+}
+
+/* llist_lookup_map returns the index lookups should use - NULL unless the container keeps its index up to date on
+ every insert and delete, in which case the list is walked instead */
+static inline struct llist_map *llist_lookup_map(struct llist_container *cont) {
+    return atomic_load_explicit(&cont->indexed, memory_order_acquire) ? cont->h_map : NULL;
+}
+
+/* llist_find_locked looks up data in the container, through the hash index if the container keeps one up to date
+ or by walking the list if not.  The caller must hold the container lock, at least for reading */
+static inline struct llist *llist_find_locked(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash) {
+    struct llist_map *map = llist_lookup_map(cont);
+    if(map)
+        return hash_map_find(map, hash, llist_match_data, data, d_size);
+    struct llist key = llist_key(data, d_size, hash);
+    struct llist *node = cont->head;
+    for(size_t i = 0; node && (!cont->is_ring || i < cont->list_entries); i++) {
+        if(llist_compare_entries(node, &key))
+            return node;
+        node = node->next;
+    }
     return NULL;
 }
 
+/* llist_find_epoch looks up data for a caller inside an epoch critical section.  Lookups through the index take no
+ lock at all, so they never wait on a writer - not even one rebuilding the index with hash_map_create.  Without an
+ index the list is walked under the read lock */
+static inline struct llist *llist_find_epoch(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash) {
+    struct llist_map *map = llist_lookup_map(cont);
+    if(map)
+        return hash_map_find(map, hash, llist_match_data, data, d_size);
+    RLOCK(cont);
+    struct llist *found = llist_find_locked(cont, data, d_size, hash);
+    RUNLOCK(cont);
+    return found;
+}
+
+/* llist_find returns a list entry whose data matches data, or NULL if there isn't one.  Lookups are expected O(1)
+ on containers that keep their index up to date - see container_set_indexed - otherwise the list is walked.  If several entries hold the same data
+ any one of them may be returned.  Index lookups are lock free, and list walks only take the lock for reading, so
+ in LLIST_LOCK_RW mode those run alongside each other too.  The entry can be deleted by another thread as soon as this returns - wrap the lookup and any
+ use of the entry in llist_epoch_enter/llist_epoch_exit to keep it and its data from being freed or reused.  For
+ LLIST_RECLAIM_HAZARD containers the entry is instead published in this thread's LLIST_HAZARD_FIND hazard slot, and
+ stays safe to use until the next lookup or llist_hazard_clear(LLIST_HAZARD_FIND) */
+struct llist *llist_find(struct llist_container *cont, const void *data, size_t d_size) {
+    if(!cont || !data || d_size == 0)
+        return NULL;
+    return llist_find_hashed(cont, data, d_size, XXH3_64bits(data, d_size));
+}
 
-    
-    
+/* llist_find_hashed is llist_find for callers that already hold XXH3_64bits of data, so it isn't hashed twice */
+struct llist *llist_find_hashed(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash) {
+    if(!cont || !data || d_size == 0)
+        return NULL;
+    struct llist *found;
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD) {
+        // Hazard pointers are published under the read lock - deletes need the lock exclusively, so the entry
+        // can't be retired before the hazard is visible.  Index updates don't need the container lock, so the
+        // epoch still keeps the index tables we probe from being freed
+        if(llist_epoch_enter() < 0)
+            return NULL;
+        RLOCK(cont);
+        found = llist_find_locked(cont, data, d_size, hash);
+        if(llist_hazard_protect(LLIST_HAZARD_FIND, found) < 0)
+            found = NULL;
+        RUNLOCK(cont);
+        llist_epoch_exit();
+        return found;
+    }
+    if(llist_epoch_enter() < 0)
+        return NULL;
+    found = llist_find_epoch(cont, data, d_size, hash);
+    llist_epoch_exit();
+    return found;
+}
+
+/* llist_delete_data deletes an entry holding data, freeing the data too if free_data is true.  The entry is found
+ and unlinked under one acquisition of the container lock, so two threads deleting the same data can't both get
+ hold of the same entry.  Returns -1 if no entry holds data */
+int llist_delete_data(struct llist_container *cont, const void *data, size_t d_size, bool free_data) {
+    if(!cont || !data || d_size == 0)
+        return -1;
+    return llist_delete_data_hashed(cont, data, d_size, XXH3_64bits(data, d_size), free_data);
+}
+
+/* llist_delete_data_hashed is llist_delete_data for callers that already hold XXH3_64bits of data */
+int llist_delete_data_hashed(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash,
+                             bool free_data) {
+    if(!cont || !data || d_size == 0)
+        return -1;
+    if(llist_epoch_enter() < 0)
+        return -1;
+    LOCK(cont);
+    // Index updates finish after the container lock is dropped, under the stripe lock - holding that too means the
+    // index agrees with the list for this hash, so we can't find an entry that has already been unlinked
+    struct llist_map *map = cont->h_map;
+    if(map)
+        hash_map_lock(map, hash);
+    struct llist *node = llist_find_locked(cont, data, d_size, hash);
+    if(!node) {
+        if(map)
+            hash_map_unlock(map, hash);
+        UNLOCK(cont);
+        llist_epoch_exit();
+        return -1;
+    }
+    llist_delete_unlock(cont, node, free_data, map != NULL);
+    llist_epoch_exit();
+    return 0;
+}
+
+/* llist_contains returns true if an entry in the list holds data */
+bool llist_contains(struct llist_container *cont, const void *data, size_t d_size) {
+    return llist_find(cont, data, d_size) != NULL;
+}
+
+/* llist_find_many looks up n items in one go, storing the matching entry (or NULL) for data[i] in found[i] and
+ returning the number of items found.  Through the index the batch runs without the lock like llist_find, otherwise
+ the container is locked once for the whole batch.  Each group of LLIST_FIND_BATCH items is hashed and prefetched
+ before any of them are probed so their cache misses overlap.  Like llist_find the entries are only safe to use
+ inside an epoch critical section.  LLIST_RECLAIM_HAZARD containers aren't supported - a thread has too few hazard
+ slots to protect a whole batch, so every entry could be reused the moment this returned - use llist_find there */
+size_t llist_find_many(struct llist_container *cont, const void **data, const size_t *d_sizes, size_t n, struct llist **found) {
+    uint64_t hashes[LLIST_FIND_BATCH];
+    size_t n_found = 0;
+    if(!cont || !data || !d_sizes || !found)
+        return 0;
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD) {
+        printf("llist_find_many doesn't support hazard pointer containers - use llist_find\n");
+        memset(found, 0, n * sizeof(struct llist *));
+        return 0;
+    }
+    if(llist_epoch_enter() < 0)
+        return 0;
+    struct llist_map *map = llist_lookup_map(cont);
+    if(!map)
+        RLOCK(cont);
+    for(size_t base = 0; base < n; base += LLIST_FIND_BATCH) {
+        size_t batch = n - base < LLIST_FIND_BATCH ? n - base : LLIST_FIND_BATCH;
+        for(size_t i = 0; i < batch; i++) {
+            if(!data[base + i] || d_sizes[base + i] == 0)
+                continue;
+            hashes[i] = XXH3_64bits(data[base + i], d_sizes[base + i]);
+            hash_map_prefetch(map, hashes[i]);
+        }
+        for(size_t i = 0; i < batch; i++) {
+            found[base + i] = NULL;
+            if(!data[base + i] || d_sizes[base + i] == 0)
+                continue;
+            if(map)
+                found[base + i] = hash_map_find(map, hashes[i], llist_match_data, data[base + i], d_sizes[base + i]);
+            else
+                found[base + i] = llist_find_locked(cont, data[base + i], d_sizes[base + i], hashes[i]);
+            if(found[base + i])
+                n_found++;
+        }
+    }
+    if(!map)
+        RUNLOCK(cont);
+    llist_epoch_exit();
+    return n_found;
+}
+
+/* llist_foreach calls fn on every entry in the list from head to tail, stopping early if fn returns false.
+ The container is only locked for reading, so in LLIST_LOCK_RW mode traversals run alongside each other and
+ alongside lookups - fn must not modify the container.  Returns the number of entries visited, or -1 */
+int llist_foreach(struct llist_container *cont, bool (*fn)(struct llist *node, void *arg), void *arg) {
+    int visited = 0;
+    if(!cont || !fn)
+        return -1;
+    if(llist_epoch_enter() < 0)
+        return -1;
+    RLOCK(cont);
+    struct llist *node = cont->head;
+    for(size_t i = 0; node && (!cont->is_ring || i < cont->list_entries); i++) {
+        visited++;
+        if(!fn(node, arg))
+            break;
+        node = node->next;
+    }
+    RUNLOCK(cont);
+    llist_epoch_exit();
+    return visited;
+}
@@ -4,14 +4,44 @@
 //
 //  Created by Andrew Alston on 05/09/2025.
 //
+
+#ifndef list_h
+#define list_h
+
 #include <stdint.h>
+#include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdatomic.h>
+#include <sys/mman.h>
 #include "xxHash/xxh3.h"
-#define HASHMAP_SIZE 20000
+#include "hashmap.h"
+#include "lock.h"
+#include "epoch.h"
+#include "hazard.h"
+#define LLIST_FIND_BATCH 16 // Lookups llist_find_many hashes and prefetches ahead of probing
+#define LLIST_POOL_MIN_SLAB 64 // Number of nodes in the first slab a container allocates
+#define LLIST_POOL_MAX_SLAB 65536 // Slabs double in size until they hold this many nodes
+#define LLIST_POOL_LIMBO 3 // Deleted nodes are kept out of reuse in one of these lists per epoch until it is safe
+#define LLIST_ARENA_BLOCK (1 << 20) // Size of the first arena block, later blocks double in size
+#define LLIST_ARENA_MAX_BLOCK (1 << 28) // Arena blocks stop doubling once they reach this size
+#define LLIST_ARENA_ALIGN 16 // Alignment of every allocation handed out by an arena
+#define LLIST_INLINE_MAX 256 // Largest payload a container can be set up to store inside its nodes
+
+#define USE_LOCK
+#define USE_NODE_POOL
+#ifndef LLIST_NO_HASH_CACHE // Defining LLIST_NO_HASH_CACHE on the command line builds without it, see bench_rebuild
+#define USE_HASH_CACHE
+#endif
+// #define USE_NODE_ALIGN // Start every node on its own cache line - pads a struct llist from 40 to 64 bytes
+
+#ifdef USE_NODE_ALIGN
+#define LLIST_NODE_ALIGN LLIST_CACHE_LINE
+#else
+#define LLIST_NODE_ALIGN 8 // Nodes, and so inline payloads, are always at least 8 byte aligned
+#endif
 
 /* struct llist defines our linked list */
 struct llist {
@@ -19,50 +49,120 @@ struct llist {
     struct llist *prev; // Previous entry in linked list
     void *data; // Data in linked list
     size_t data_size;
+#ifdef USE_HASH_CACHE
+    uint64_t hash; // XXH3_64bits of data, computed whenever the data is set
+#endif
+};
+
+/* struct llist_slab is a single allocation that nodes are carved out of */
+struct llist_slab {
+    struct llist_slab *next; // Previously allocated slab
+    size_t n_nodes; // Number of nodes this slab can hold
+    size_t used; // Number of nodes handed out from this slab so far
+    struct llist nodes[] __attribute__((aligned(LLIST_NODE_ALIGN)));
+};
+
+/* struct llist_arena_block is a single mmap'd region that an arena bump allocates from */
+struct llist_arena_block {
+    struct llist_arena_block *next; // Previously mapped block
+    size_t size; // Size of the mapping including this header
+    size_t used; // Bytes handed out from this block including this header
+};
+
+/* struct llist_arena is a bump allocator - nothing allocated from it is ever freed individually,
+ the whole arena is unmapped in one go when the container is freed */
+struct llist_arena {
+    struct llist_arena_block *blocks; // Most recently mapped block, older blocks hang off its next pointer
+    size_t next_block; // Size of the next block to map
 };
 
-struct llist_collision {
-    struct llist_collision *next;
-    struct llist *entry;
-    uint64_t hash;
+/* struct llist_pool is a per container node allocator - deleted nodes are reused before any new slab is allocated,
+ but only once every reader that might still be looking at them has left its epoch critical section */
+struct llist_pool {
+    struct llist_slab *slabs; // Most recently allocated slab, older slabs hang off its next pointer
+    struct llist *free_list; // Deleted nodes that are safe to reuse, linked through their next pointer
+    struct llist *limbo[LLIST_POOL_LIMBO]; // Deleted nodes not yet safe to reuse, linked through their prev pointer
+    uint64_t limbo_epoch[LLIST_POOL_LIMBO]; // Epoch the nodes in each limbo list were deleted in
+    struct llist *hazard_retired; // Deleted nodes of a hazard pointer container not yet scanned, linked through prev
+    size_t n_hazard_retired;
+    size_t next_slab; // Number of nodes to allocate in the next slab
+    size_t node_size; // Bytes each node takes up in a slab - a struct llist plus inline payload room, rounded up to LLIST_NODE_ALIGN
+    struct llist_arena *arena; // If set slabs are carved out of this arena rather than malloc'd
 };
 
-struct llist_map {
-    struct llist *entry;
-    uint64_t hash;
-    struct llist_collision *collision;
+/* enum llist_reclaim selects how a container keeps deleted nodes alive for readers that may still be using them */
+enum llist_reclaim {
+    LLIST_RECLAIM_EPOCH = 0, // Wait out two epochs - cheapest for readers, but a stalled reader holds up everything
+    LLIST_RECLAIM_HAZARD, // Wait until no hazard pointer protects the node - memory waiting to be reused stays bounded
 };
 
-/* struct llist_container contains the list, as well as tracking pointers for the head and tail of the list */
+/* struct llist_container contains the list, as well as tracking pointers for the head and tail of the list.
+ Fields are grouped by how they are used, each group starting on its own cache line: settings that are read by
+ every operation - including lookups that take no lock - but almost never written, the lock word, and the list
+ state written by every insert and delete.  Threads spinning on the lock or rewriting head and tail then don't keep
+ pulling the line lock free readers need out from under them.  Containers are allocated cache line aligned */
 struct llist_container {
-    struct llist *list; // Linked list pointer that can point anywhere on the list
+    _Alignas(LLIST_CACHE_LINE) struct llist_map *_Atomic h_map; // Hash index of the list entries - NULL until first built, read by lookups without the lock
+    enum llist_lock_type lock_type; // Spin, adaptive or reader-writer locking, set with container_set_lock_type
+    enum llist_reclaim reclaim; // How deleted nodes are kept from readers, set with container_set_reclaim
+    _Atomic(bool) use_lock; // This is set if we are using locking - though not technically necessary
+    bool is_ring; // If this is set then head and tail have no meaning since the linked list forms a complete ring
+    _Atomic(bool) indexed; // If set every insert and delete updates h_map and lookups use it, see container_set_indexed
+    size_t inline_size; // Payloads up to this size are copied into the node itself, see container_set_inline_size
+    struct llist_rwlock *rw; // Reader-writer lock used in place of locked when lock_type is LLIST_LOCK_RW
+    struct llist_arena *arena; // Set for containers created with container_new_arena
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint32_t) locked; // Atomic Lock - see lock.h for the values it takes
+    _Alignas(LLIST_CACHE_LINE) struct llist *list; // Linked list pointer that can point anywhere on the list
     struct llist *head; // Linked list pointer that should always point to the head of the list
     struct llist *tail; // Linked list pointer that should always point to the tail of the list
-    bool is_ring; // If this is set then head and tail have no meaning since the linked list forms a complete ring
     size_t list_entries;
-    _Atomic(bool) use_lock; // This is set if we are using locking - though not technically necessary
-    _Atomic(bool) locked; // Atomic Lock
-    struct llist_map *h_map[HASHMAP_SIZE];
+    struct llist_pool pool; // Node allocator - only used when USE_NODE_POOL is defined
 };
 
-#define USE_LOCK
-
 #ifdef USE_LOCK
 #define LOCK(container) ({ \
-    while(atomic_load(&container->locked)) { \
-        continue; \
-    } \
-    printf("Taking lock\n"); \
-    atomic_store(&container->locked, true); \
+    if((container)->lock_type == LLIST_LOCK_RW) \
+        llist_write_lock((container)->rw); \
+    else \
+        llist_lock(&(container)->locked, (container)->lock_type); \
+})
+#define UNLOCK(container) ({ \
+    if((container)->lock_type == LLIST_LOCK_RW) \
+        llist_write_unlock((container)->rw); \
+    else \
+        llist_unlock(&(container)->locked, (container)->lock_type); \
+})
+/* RLOCK takes the container lock for reading - shared with other readers in LLIST_LOCK_RW mode, otherwise the
+ same as LOCK.  Nothing in the container, including the list pointer, may be modified under RLOCK */
+#define RLOCK(container) ({ \
+    if((container)->lock_type == LLIST_LOCK_RW) \
+        llist_read_lock((container)->rw); \
+    else \
+        llist_lock(&(container)->locked, (container)->lock_type); \
+})
+#define RUNLOCK(container) ({ \
+    if((container)->lock_type == LLIST_LOCK_RW) \
+        llist_read_unlock((container)->rw); \
+    else \
+        llist_unlock(&(container)->locked, (container)->lock_type); \
 })
-#define UNLOCK(container) ({ printf("Unlocking\n"); atomic_store(&container->locked, false); })
 #else
 #define LOCK(container) ({})
 #define UNLOCK(container) ({})
+#define RLOCK(container) ({})
+#define RUNLOCK(container) ({})
 #endif
 
-struct llist *llist_new(void *data, size_t d_size);
+struct llist *llist_new(void *data, size_t d_size); // Not pooled - see llist_pool_new
+struct llist *llist_pool_new(struct llist_container *cont, void *data, size_t d_size);
 struct llist_container *container_new(void);
+struct llist_container *container_new_arena(void);
+struct llist_container *container_new_indexed(void);
+int container_set_indexed(struct llist_container *cont, bool indexed);
+int container_set_lock_type(struct llist_container *cont, enum llist_lock_type lock_type);
+int container_set_reclaim(struct llist_container *cont, enum llist_reclaim reclaim);
+int container_set_inline_size(struct llist_container *cont, size_t inline_size);
+void container_free(struct llist_container *cont, bool free_data);
 int llist_set_data(struct llist_container *cont, void *data, size_t d_size);
 int llist_add_head_data(struct llist_container *cont, void *data, size_t d_size);
 int llist_add_tail_data(struct llist_container *cont, void *data, size_t d_size);
@@ -73,8 +173,50 @@ int list_set_from_array(struct llist_container *cont, void *array_head, size_t e
 struct llist_container *container_new_list(int list_entries);
 int llist_insert_between(struct llist_container *cont, struct llist *first, struct llist *second, void *data, size_t d_size);
 int llist_delete_node(struct llist_container *cont, struct llist *node, bool free_data);
+int llist_delete_data(struct llist_container *cont, const void *data, size_t d_size, bool free_data);
+int llist_delete_data_hashed(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash,
+                             bool free_data);
 int llist_insert_data_copy(struct llist_container *cont, struct llist *node, void *data, size_t d_size);
-struct llist_map **hash_map_create(struct llist_container *cont);
-static inline bool llist_compare_entries(struct llist *entry1, struct llist *entry2);
+struct llist_map *hash_map_create(struct llist_container *cont);
+struct llist *llist_find(struct llist_container *cont, const void *data, size_t d_size);
+struct llist *llist_find_hashed(struct llist_container *cont, const void *data, size_t d_size, uint64_t hash);
+bool llist_contains(struct llist_container *cont, const void *data, size_t d_size);
+int llist_foreach(struct llist_container *cont, bool (*fn)(struct llist *node, void *arg), void *arg);
+size_t llist_find_many(struct llist_container *cont, const void **data, const size_t *d_sizes, size_t n, struct llist **found);
 
+/* llist_set_node_data points a node at data, caching the hash of the data if USE_HASH_CACHE is defined.
+ NOTE: The cached hash goes stale if the data is modified in place - set it again after changing it */
+static inline void llist_set_node_data(struct llist *node, void *data, size_t d_size) {
+    node->data = data;
+    node->data_size = d_size;
+#ifdef USE_HASH_CACHE
+    node->hash = (data && d_size) ? XXH3_64bits(data, d_size) : 0;
+#endif
+}
+
+/* llist_node_inline returns the payload room allocated straight after a node, for containers set up with
+ container_set_inline_size */
+static inline void *llist_node_inline(struct llist *node) {
+    return node + 1;
+}
+
+/* llist_node_hash returns the hash of the data in a node, from the cached copy if USE_HASH_CACHE is defined */
+static inline uint64_t llist_node_hash(struct llist *node) {
+#ifdef USE_HASH_CACHE
+    return node->hash;
+#else
+    return XXH3_64bits(node->data, node->data_size);
+#endif
+}
+
+/* llist_compare_entries compares the data between two linked list entries - with USE_HASH_CACHE the cached hashes
+ are compared first so memcmp is only run when the data almost certainly matches */
+static inline bool llist_compare_entries(struct llist *entry1, struct llist *entry2) {
+    return (entry1 && entry2 && (entry1->data_size == entry2->data_size) &&
+#ifdef USE_HASH_CACHE
+            (entry1->hash == entry2->hash) &&
+#endif
+            !memcmp(entry1->data, entry2->data, entry1->data_size));
+}
 
+#endif /* list_h */
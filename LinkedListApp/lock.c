@@ -0,0 +1,64 @@
+//
+//  lock.c
+//  LinkedListApp
+//
+//  Slow paths for the container locks - parking and waking threads, and reader-writer lock setup.
+//
+
+#include <sched.h>
+#include <stdlib.h>
+#include "lock.h"
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* llist_futex_wait parks the calling thread for as long as *lock still holds val.  It may return early, so
+ callers must recheck the lock.  Without futexes we just give up the CPU and let the caller recheck */
+void llist_futex_wait(_Atomic(uint32_t) *lock, uint32_t val) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)lock, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    (void)lock;
+    (void)val;
+    sched_yield();
+#endif
+}
+
+/* llist_futex_wake wakes one thread parked on lock */
+void llist_futex_wake(_Atomic(uint32_t) *lock) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)lock, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    (void)lock;
+#endif
+}
+
+_Thread_local int llist_rw_slot = -1; // Reader counter slot used by this thread, -1 until first assigned
+static _Atomic(unsigned int) llist_rw_next_slot; // Slots are handed out to threads round robin
+
+/* llist_rw_slot_assign picks the reader counter slot for the calling thread the first time it takes a read lock.
+ Threads keep their slot for life, so a read unlock always decrements the counter its read lock incremented even
+ if the thread has moved CPU in between */
+int llist_rw_slot_assign(void) {
+    llist_rw_slot = atomic_fetch_add_explicit(&llist_rw_next_slot, 1, memory_order_relaxed) % LLIST_RW_SLOTS;
+    return llist_rw_slot;
+}
+
+/* llist_rwlock_new allocates an unlocked reader-writer lock, cache line aligned so its counters don't share
+ lines with anything else */
+struct llist_rwlock *llist_rwlock_new(void) {
+    struct llist_rwlock *rw = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_rwlock));
+    if(!rw)
+        return NULL;
+    atomic_init(&rw->writer, 0);
+    for(int i = 0; i < LLIST_RW_SLOTS; i++)
+        atomic_init(&rw->readers[i].count, 0);
+    return rw;
+}
+
+/* llist_rwlock_free frees a reader-writer lock, which must not be held */
+void llist_rwlock_free(struct llist_rwlock *rw) {
+    free(rw);
+}
@@ -0,0 +1,173 @@
+//
+//  lock.h
+//  LinkedListApp
+//
+//  Locks used by the linked list containers.  A lock is a single 32 bit atomic word:
+//  0 when free, 1 when held, and for adaptive locks 2 when held with threads parked waiting for it.
+//
+
+#ifndef lock_h
+#define lock_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define LLIST_SPIN_MAX_BACKOFF 64 // Most pause instructions a spinning thread waits between looks at a lock
+#define LLIST_ADAPTIVE_SPINS 100 // Attempts an adaptive lock makes at taking the lock before parking
+#define LLIST_RW_SLOTS 16 // Reader counters in a reader-writer lock, each on its own cache line
+#define LLIST_CACHE_LINE 64
+
+#define LLIST_LOCK_FREE 0
+#define LLIST_LOCK_HELD 1
+#define LLIST_LOCK_PARKED 2 // Held, and at least one thread may be parked waiting on it
+
+/* enum llist_lock_type selects how a container waits for its lock */
+enum llist_lock_type {
+    LLIST_LOCK_SPIN = 0, // Spin with backoff until the lock is free - best for short critical sections
+    LLIST_LOCK_ADAPTIVE, // Spin briefly, then park on a futex until the holder wakes us
+    LLIST_LOCK_RW, // Reader-writer lock - lookups and traversals share it, anything that modifies takes it exclusively
+};
+
+/* struct llist_rwlock is a writer preferring reader-writer spin lock.  Rather than every reader incrementing one
+ shared count, each thread is given one of LLIST_RW_SLOTS reader counters, each on its own cache line, so readers on
+ different cores rarely touch the same line.  A writer raises the writer flag, which stops new readers getting in,
+ then waits for every reader counter to drain */
+struct llist_rwlock {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint32_t) writer; // Set while a writer holds or is waiting for the lock
+    struct {
+        _Alignas(LLIST_CACHE_LINE) _Atomic(uint32_t) count;
+    } readers[LLIST_RW_SLOTS];
+};
+
+extern _Thread_local int llist_rw_slot;
+int llist_rw_slot_assign(void);
+struct llist_rwlock *llist_rwlock_new(void);
+void llist_rwlock_free(struct llist_rwlock *rw);
+
+void llist_futex_wait(_Atomic(uint32_t) *lock, uint32_t val);
+void llist_futex_wake(_Atomic(uint32_t) *lock);
+
+/* llist_cpu_relax tells the CPU we are in a spin loop, which saves power and gives a hyperthread sibling
+ (possibly the lock holder) the core */
+static inline void llist_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/* llist_spin_lock takes a spin lock.  The lock is only written when it looks free, waiting threads spin on a
+ relaxed load so they don't keep stealing the cache line from the holder, and the pause between loads backs off
+ exponentially up to LLIST_SPIN_MAX_BACKOFF pauses */
+static inline void llist_spin_lock(_Atomic(uint32_t) *lock) {
+    unsigned int backoff = 1;
+    uint32_t expected = LLIST_LOCK_FREE;
+    while(!atomic_compare_exchange_weak_explicit(lock, &expected, LLIST_LOCK_HELD, memory_order_acquire, memory_order_relaxed)) {
+        while(atomic_load_explicit(lock, memory_order_relaxed) != LLIST_LOCK_FREE) {
+            for(unsigned int i = 0; i < backoff; i++)
+                llist_cpu_relax();
+            if(backoff < LLIST_SPIN_MAX_BACKOFF)
+                backoff <<= 1;
+        }
+        expected = LLIST_LOCK_FREE;
+    }
+}
+
+/* llist_spin_unlock releases a spin lock taken with llist_spin_lock */
+static inline void llist_spin_unlock(_Atomic(uint32_t) *lock) {
+    atomic_store_explicit(lock, LLIST_LOCK_FREE, memory_order_release);
+}
+
+/* llist_adaptive_lock takes an adaptive lock.  An uncontended lock is a single compare and exchange.  Under
+ contention we spin for LLIST_ADAPTIVE_SPINS attempts in case the holder is about to let go, then mark the lock
+ as having waiters and park on the futex so we stop burning a core the holder could be using */
+static inline void llist_adaptive_lock(_Atomic(uint32_t) *lock) {
+    uint32_t state = LLIST_LOCK_FREE;
+    if(atomic_compare_exchange_strong_explicit(lock, &state, LLIST_LOCK_HELD, memory_order_acquire, memory_order_relaxed))
+        return;
+    for(int i = 0; i < LLIST_ADAPTIVE_SPINS && state != LLIST_LOCK_PARKED; i++) {
+        llist_cpu_relax();
+        state = LLIST_LOCK_FREE;
+        if(atomic_compare_exchange_weak_explicit(lock, &state, LLIST_LOCK_HELD, memory_order_acquire, memory_order_relaxed))
+            return;
+    }
+    // Once we have marked the lock as parked we have to keep it marked when we take it, since we can't know
+    // whether other threads are still parked behind us
+    while(atomic_exchange_explicit(lock, LLIST_LOCK_PARKED, memory_order_acquire) != LLIST_LOCK_FREE)
+        llist_futex_wait(lock, LLIST_LOCK_PARKED);
+}
+
+/* llist_adaptive_unlock releases an adaptive lock, waking a parked thread if there might be one */
+static inline void llist_adaptive_unlock(_Atomic(uint32_t) *lock) {
+    if(atomic_exchange_explicit(lock, LLIST_LOCK_FREE, memory_order_release) == LLIST_LOCK_PARKED)
+        llist_futex_wake(lock);
+}
+
+/* llist_lock takes a lock of the given type */
+static inline void llist_lock(_Atomic(uint32_t) *lock, enum llist_lock_type type) {
+    if(type == LLIST_LOCK_ADAPTIVE)
+        llist_adaptive_lock(lock);
+    else
+        llist_spin_lock(lock);
+}
+
+/* llist_unlock releases a lock of the given type */
+static inline void llist_unlock(_Atomic(uint32_t) *lock, enum llist_lock_type type) {
+    if(type == LLIST_LOCK_ADAPTIVE)
+        llist_adaptive_unlock(lock);
+    else
+        llist_spin_unlock(lock);
+}
+
+/* llist_rw_my_slot returns the reader counter slot the calling thread uses */
+static inline int llist_rw_my_slot(void) {
+    return llist_rw_slot >= 0 ? llist_rw_slot : llist_rw_slot_assign();
+}
+
+/* llist_read_lock takes a reader-writer lock shared.  We wait for any writer to finish before registering as a
+ reader, and back out again if a writer turned up while we were registering, so writers never starve */
+static inline void llist_read_lock(struct llist_rwlock *rw) {
+    _Atomic(uint32_t) *count = &rw->readers[llist_rw_my_slot()].count;
+    for(;;) {
+        while(atomic_load_explicit(&rw->writer, memory_order_relaxed))
+            llist_cpu_relax();
+        atomic_fetch_add_explicit(count, 1, memory_order_seq_cst);
+        if(!atomic_load_explicit(&rw->writer, memory_order_seq_cst))
+            return;
+        atomic_fetch_sub_explicit(count, 1, memory_order_release);
+    }
+}
+
+/* llist_read_unlock releases a reader-writer lock taken with llist_read_lock */
+static inline void llist_read_unlock(struct llist_rwlock *rw) {
+    atomic_fetch_sub_explicit(&rw->readers[llist_rw_my_slot()].count, 1, memory_order_release);
+}
+
+/* llist_write_lock takes a reader-writer lock exclusively - claiming the writer flag first, then waiting for the
+ readers that got in before us to leave */
+static inline void llist_write_lock(struct llist_rwlock *rw) {
+    uint32_t expected = 0;
+    unsigned int backoff = 1;
+    while(!atomic_compare_exchange_weak_explicit(&rw->writer, &expected, 1, memory_order_seq_cst, memory_order_relaxed)) {
+        while(atomic_load_explicit(&rw->writer, memory_order_relaxed)) {
+            for(unsigned int i = 0; i < backoff; i++)
+                llist_cpu_relax();
+            if(backoff < LLIST_SPIN_MAX_BACKOFF)
+                backoff <<= 1;
+        }
+        expected = 0;
+    }
+    for(int i = 0; i < LLIST_RW_SLOTS; i++) {
+        while(atomic_load_explicit(&rw->readers[i].count, memory_order_acquire))
+            llist_cpu_relax();
+    }
+}
+
+/* llist_write_unlock releases a reader-writer lock taken with llist_write_lock */
+static inline void llist_write_unlock(struct llist_rwlock *rw) {
+    atomic_store_explicit(&rw->writer, 0, memory_order_release);
+}
+
+#endif /* lock_h */
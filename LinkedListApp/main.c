@@ -51,12 +51,12 @@ int main(int argc, const char * argv[]) {
         container->list = container->list->next;
     }
     UNLOCK(container);
-    struct llist_map **h_map = hash_map_create(container);
-    for(int i = 0; i < HASHMAP_SIZE; i++) {
-        if(h_map[i]) {
-            printf("Hash entry %llu had data %llu\n", h_map[i]->hash, *(uint64_t*)h_map[i]->entry->data);
-        }
+    struct llist_map *h_map = hash_map_create(container);
+    struct llist_map_slot *slot;
+    size_t pos = 0;
+    while((slot = hash_map_next(h_map, &pos))) {
+        printf("Hash entry %llu had data %llu\n", slot->hash, *(uint64_t*)((struct llist *)slot->entry)->data);
     }
-    
+    container_free(container, false);
     return 0;
 }
@@ -0,0 +1,393 @@
+//
+//  ring.c
+//  LinkedListApp
+//
+//  Array backed ring buffers - the locked ring, the single producer, single consumer ring and the multi producer,
+//  multi consumer ring.
+//
+
+#include <sched.h>
+#include <stdio.h>
+#include "list.h"
+#include "ring.h"
+
+#define RING_LOCK(ring) ({ \
+    if((ring)->use_lock) \
+        llist_spin_lock(&(ring)->locked); \
+})
+#define RING_UNLOCK(ring) ({ \
+    if((ring)->use_lock) \
+        llist_spin_unlock(&(ring)->locked); \
+})
+
+/* ring_slots_alloc allocates the slot array of a ring, cache line aligned.  aligned_alloc needs a size that is a
+ multiple of the alignment, which small rings and the 24 byte MPMC slots don't give us, so the size is rounded up */
+static void *ring_slots_alloc(size_t size) {
+    return aligned_alloc(LLIST_CACHE_LINE, (size + LLIST_CACHE_LINE - 1) & ~(size_t)(LLIST_CACHE_LINE - 1));
+}
+
+/* ring_container_new creates an empty ring holding capacity entries, rounded up to a power of two */
+struct llist_ring *ring_container_new(size_t capacity) {
+    size_t size = LLIST_RING_MIN;
+    if(capacity > LLIST_RING_MAX) {
+        printf("Ring capacity too large\n");
+        return NULL;
+    }
+    while(size < capacity)
+        size <<= 1;
+    struct llist_ring *new = calloc(1, sizeof(struct llist_ring));
+    if(!new)
+        return NULL;
+    new->slots = ring_slots_alloc(size * sizeof(struct llist_ring_slot));
+    if(!new->slots) {
+        free(new);
+        return NULL;
+    }
+    atomic_init(&new->locked, LLIST_LOCK_FREE);
+#ifdef USE_LOCK
+    new->use_lock = true;
+#endif
+    new->mask = size - 1;
+    return new;
+}
+
+/* ring_container_free frees a ring, freeing the data of every entry still in it if free_data is true */
+void ring_container_free(struct llist_ring *ring, bool free_data) {
+    if(!ring)
+        return;
+    if(free_data) {
+        for(uint64_t pos = ring->head; pos != ring->tail; pos++)
+            free(ring->slots[pos & ring->mask].data);
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+/* ring_container_set_lock turns locking on or off for a ring.  The lock is the bulk of the cost of a push or pop, so
+ a ring only ever touched by one thread at a time can go without it.  This must be called while no other thread is
+ using the ring */
+int ring_container_set_lock(struct llist_ring *ring, bool use_lock) {
+    if(!ring || atomic_load(&ring->locked) != LLIST_LOCK_FREE)
+        return -1;
+    ring->use_lock = use_lock;
+    return 0;
+}
+
+/* llist_ring_entries returns the number of entries in the ring */
+size_t llist_ring_entries(struct llist_ring *ring) {
+    if(!ring)
+        return 0;
+    RING_LOCK(ring);
+    size_t entries = ring->tail - ring->head;
+    RING_UNLOCK(ring);
+    return entries;
+}
+
+/* llist_ring_push adds an entry pointing at data to the ring.  If the ring is full the oldest entry is overwritten -
+ its data is not freed.  Returns 1 if an entry was overwritten, 0 if not, or -1 on error */
+int llist_ring_push(struct llist_ring *ring, void *data, size_t d_size) {
+    int overwrote = 0;
+    if(!ring)
+        return -1;
+    RING_LOCK(ring);
+    if(ring->tail - ring->head > ring->mask) {
+        ring->head++;
+        overwrote = 1;
+    }
+    struct llist_ring_slot *slot = &ring->slots[ring->tail & ring->mask];
+    slot->data = data;
+    slot->data_size = d_size;
+    ring->tail++;
+    RING_UNLOCK(ring);
+    return overwrote;
+}
+
+/* llist_ring_pop removes the oldest entry from the ring, returning its data through data and d_size.
+ Returns -1 if the ring is empty */
+int llist_ring_pop(struct llist_ring *ring, void **data, size_t *d_size) {
+    if(!ring)
+        return -1;
+    RING_LOCK(ring);
+    if(ring->head == ring->tail) {
+        RING_UNLOCK(ring);
+        return -1;
+    }
+    struct llist_ring_slot *slot = &ring->slots[ring->head & ring->mask];
+    if(data)
+        *data = slot->data;
+    if(d_size)
+        *d_size = slot->data_size;
+    ring->head++;
+    RING_UNLOCK(ring);
+    return 0;
+}
+
+/* llist_ring_peek returns the data of the entry index places after the oldest without removing it - index 0 is the
+ entry llist_ring_pop would return next.  Returns -1 if the ring holds no entry at index */
+int llist_ring_peek(struct llist_ring *ring, size_t index, void **data, size_t *d_size) {
+    if(!ring)
+        return -1;
+    RING_LOCK(ring);
+    if(index >= ring->tail - ring->head) {
+        RING_UNLOCK(ring);
+        return -1;
+    }
+    struct llist_ring_slot *slot = &ring->slots[(ring->head + index) & ring->mask];
+    if(data)
+        *data = slot->data;
+    if(d_size)
+        *d_size = slot->data_size;
+    RING_UNLOCK(ring);
+    return 0;
+}
+
+/* llist_ring_foreach calls fn on every entry from the oldest to the newest, stopping early if fn returns false.  The
+ lock is taken once for the whole walk, which runs straight along the slot array - at most two runs of contiguous
+ slots, either side of the wrap.  fn must not push or pop.  Returns the number of entries visited, or -1 */
+long llist_ring_foreach(struct llist_ring *ring, bool (*fn)(struct llist_ring_slot *slot, void *arg), void *arg) {
+    long visited = 0;
+    if(!ring || !fn)
+        return -1;
+    RING_LOCK(ring);
+    size_t entries = ring->tail - ring->head, start = ring->head & ring->mask;
+    // Entries from start up to the end of the array, then whatever wrapped round to the front
+    size_t first = entries < ring->mask + 1 - start ? entries : ring->mask + 1 - start;
+    for(size_t i = 0; i < entries; i++) {
+        visited++;
+        if(!fn(&ring->slots[i < first ? start + i : i - first], arg))
+            break;
+    }
+    RING_UNLOCK(ring);
+    return visited;
+}
+
+/* ring_set_from_array pushes n_entries entries of entry_size bytes from an array onto the ring, wrapping round and
+ overwriting the oldest entries once it is full just as list_set_from_array does on a linked ring.
+ NOTE: This does not copy data from the array - it merely points to array entries */
+int ring_set_from_array(struct llist_ring *ring, void *array_head, size_t entry_size, size_t n_entries) {
+    if(!ring || !array_head)
+        return -1;
+    if(n_entries > llist_ring_capacity(ring))
+        printf("Warning: array entries exceeds ring entries - early array entries will be overwritten on the ring\n");
+    RING_LOCK(ring);
+    for(size_t i = 0; i < n_entries; i++) {
+        if(ring->tail - ring->head > ring->mask)
+            ring->head++;
+        struct llist_ring_slot *slot = &ring->slots[ring->tail & ring->mask];
+        slot->data = array_head;
+        slot->data_size = entry_size;
+        ring->tail++;
+        array_head += entry_size;
+    }
+    RING_UNLOCK(ring);
+    return 0;
+}
+
+/* spsc_ring_new creates an empty single producer, single consumer ring holding capacity entries, rounded up to a
+ power of two */
+struct llist_spsc_ring *spsc_ring_new(size_t capacity) {
+    size_t size = LLIST_RING_MIN;
+    if(capacity > LLIST_RING_MAX) {
+        printf("Ring capacity too large\n");
+        return NULL;
+    }
+    while(size < capacity)
+        size <<= 1;
+    struct llist_spsc_ring *new = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_spsc_ring));
+    if(!new)
+        return NULL;
+    memset(new, 0, sizeof(struct llist_spsc_ring));
+    new->slots = ring_slots_alloc(size * sizeof(struct llist_ring_slot));
+    if(!new->slots) {
+        free(new);
+        return NULL;
+    }
+    atomic_init(&new->head, 0);
+    atomic_init(&new->tail, 0);
+    new->mask = size - 1;
+    return new;
+}
+
+/* spsc_ring_free frees a single producer, single consumer ring, freeing the data of every entry still in it if
+ free_data is true.  Neither the producer nor the consumer may still be using it */
+void spsc_ring_free(struct llist_spsc_ring *ring, bool free_data) {
+    if(!ring)
+        return;
+    if(free_data) {
+        uint64_t tail = atomic_load(&ring->tail);
+        for(uint64_t pos = atomic_load(&ring->head); pos != tail; pos++)
+            free(ring->slots[pos & ring->mask].data);
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+/* llist_spsc_push_many pushes up to n entries, data[i] with size d_sizes[i], as one batch - the tail is published
+ once for the whole batch, so the consumer sees all of it or none of it.  Only the producer thread may call this.
+ Returns the number of entries pushed, fewer than n if the ring filled up */
+size_t llist_spsc_push_many(struct llist_spsc_ring *ring, void **data, const size_t *d_sizes, size_t n) {
+    if(!ring || !data || !d_sizes)
+        return 0;
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t space = ring->mask + 1 - (tail - ring->head_cache);
+    if(space < n) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        space = ring->mask + 1 - (tail - ring->head_cache);
+        if(space < n)
+            n = space;
+    }
+    for(size_t i = 0; i < n; i++) {
+        struct llist_ring_slot *slot = &ring->slots[(tail + i) & ring->mask];
+        slot->data = data[i];
+        slot->data_size = d_sizes[i];
+    }
+    if(n)
+        atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/* llist_spsc_pop_many pops up to n of the oldest entries as one batch, storing their data in data and their sizes
+ in d_sizes if it isn't NULL.  Only the consumer thread may call this.  Returns the number of entries popped */
+size_t llist_spsc_pop_many(struct llist_spsc_ring *ring, void **data, size_t *d_sizes, size_t n) {
+    if(!ring || !data)
+        return 0;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t avail = ring->tail_cache - head;
+    if(avail < n) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        avail = ring->tail_cache - head;
+        if(avail < n)
+            n = avail;
+    }
+    for(size_t i = 0; i < n; i++) {
+        struct llist_ring_slot *slot = &ring->slots[(head + i) & ring->mask];
+        data[i] = slot->data;
+        if(d_sizes)
+            d_sizes[i] = slot->data_size;
+    }
+    if(n)
+        atomic_store_explicit(&ring->head, head + n, memory_order_release);
+    return n;
+}
+
+/* mpmc_ring_new creates an empty multi producer, multi consumer ring holding capacity entries, rounded up to a
+ power of two */
+struct llist_mpmc_ring *mpmc_ring_new(size_t capacity) {
+    size_t size = LLIST_RING_MIN;
+    if(capacity > LLIST_RING_MAX) {
+        printf("Ring capacity too large\n");
+        return NULL;
+    }
+    while(size < capacity)
+        size <<= 1;
+    struct llist_mpmc_ring *new = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct llist_mpmc_ring));
+    if(!new)
+        return NULL;
+    memset(new, 0, sizeof(struct llist_mpmc_ring));
+    new->slots = ring_slots_alloc(size * sizeof(struct llist_mpmc_slot));
+    if(!new->slots) {
+        free(new);
+        return NULL;
+    }
+    // Every slot starts out free for the first push at its position
+    for(size_t i = 0; i < size; i++)
+        atomic_init(&new->slots[i].seq, i);
+    atomic_init(&new->head, 0);
+    atomic_init(&new->tail, 0);
+    new->mask = size - 1;
+    return new;
+}
+
+/* mpmc_ring_free frees a multi producer, multi consumer ring, freeing the data of every entry still in it if
+ free_data is true.  No other thread may still be using it */
+void mpmc_ring_free(struct llist_mpmc_ring *ring, bool free_data) {
+    void *data;
+    if(!ring)
+        return;
+    while(free_data && llist_mpmc_try_pop(ring, &data, NULL) == 0)
+        free(data);
+    free(ring->slots);
+    free(ring);
+}
+
+/* llist_mpmc_try_push adds an entry pointing at data to the ring without waiting.  Returns -1 if the ring is full */
+int llist_mpmc_try_push(struct llist_mpmc_ring *ring, void *data, size_t d_size) {
+    struct llist_mpmc_slot *slot;
+    uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for(;;) {
+        slot = &ring->slots[pos & ring->mask];
+        // Acquire pairs with the release by the consumer that last emptied the slot
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if(diff == 0) {
+            // The slot is free for this position - claim the position, or retry with whatever it has moved on to
+            if(atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if(diff < 0) {
+            // The slot still holds the entry from a lap ago, so the ring is full
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+    slot->data = data;
+    slot->data_size = d_size;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+/* llist_mpmc_try_pop removes the oldest entry from the ring without waiting, returning its data through data and
+ d_size.  Returns -1 if the ring is empty */
+int llist_mpmc_try_pop(struct llist_mpmc_ring *ring, void **data, size_t *d_size) {
+    struct llist_mpmc_slot *slot;
+    uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for(;;) {
+        slot = &ring->slots[pos & ring->mask];
+        // Acquire pairs with the release by the producer that filled the slot
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if(diff < 0) {
+            // Nothing has been pushed at this position yet, so the ring is empty
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+    if(data)
+        *data = slot->data;
+    if(d_size)
+        *d_size = slot->data_size;
+    // Hand the slot on to the producer that will push one lap later
+    atomic_store_explicit(&slot->seq, pos + ring->mask + 1, memory_order_release);
+    return 0;
+}
+
+/* llist_mpmc_wait backs off after a failed push or pop - spinning with exponential backoff at first, then yielding
+ the CPU so that a producer or consumer we are waiting on gets to run */
+static inline void llist_mpmc_wait(unsigned int *tries) {
+    if(*tries < LLIST_RING_SPINS) {
+        unsigned int backoff = *tries < 6 ? 1u << *tries : LLIST_SPIN_MAX_BACKOFF;
+        for(unsigned int i = 0; i < backoff; i++)
+            llist_cpu_relax();
+        (*tries)++;
+    } else {
+        sched_yield();
+    }
+}
+
+/* llist_mpmc_push adds an entry pointing at data to the ring, waiting for a consumer to make room if it is full */
+void llist_mpmc_push(struct llist_mpmc_ring *ring, void *data, size_t d_size) {
+    unsigned int tries = 0;
+    while(llist_mpmc_try_push(ring, data, d_size) < 0)
+        llist_mpmc_wait(&tries);
+}
+
+/* llist_mpmc_pop removes the oldest entry from the ring, waiting for a producer to push one if it is empty */
+void llist_mpmc_pop(struct llist_mpmc_ring *ring, void **data, size_t *d_size) {
+    unsigned int tries = 0;
+    while(llist_mpmc_try_pop(ring, data, d_size) < 0)
+        llist_mpmc_wait(&tries);
+}
@@ -0,0 +1,137 @@
+//
+//  ring.h
+//  LinkedListApp
+//
+//  Array backed ring buffer.  container_new_ring builds a ring out of separately allocated nodes, so stepping round
+//  it chases a pointer and usually misses cache on every entry.  This keeps the entries in one array instead, sized
+//  to a power of two so a position is just a counter masked down to a slot.  The head and tail counters only ever
+//  count up, so the number of entries is always tail - head.  Like container_new_ring the ring has a fixed size and
+//  pushing onto a full ring overwrites the oldest entry.
+//  struct llist_spsc_ring is a lock free variant for exactly one producer thread and one consumer thread.  Each
+//  side only ever writes its own counter, on its own cache line, and keeps a cached copy of the other side's
+//  counter that it only refreshes when the ring looks full or empty, so most operations touch no shared line at
+//  all.  Every operation finishes in a fixed number of steps - a full ring refuses a push rather than overwriting.
+//  struct llist_mpmc_ring is a bounded queue for any number of producers and consumers, after Dmitry Vyukov's
+//  design.  Every slot carries a sequence number saying whose turn it is - a producer may fill slot pos once its
+//  sequence is pos, a consumer may empty it once its sequence is pos + 1 - so producers and consumers only contend
+//  on claiming a position with a compare and exchange and never on a lock.
+//
+
+#ifndef ring_h
+#define ring_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#define LLIST_RING_MIN 2 // Smallest ring capacity, capacities are always a power of two
+#define LLIST_RING_MAX ((size_t)1 << 32) // Largest ring capacity
+#define LLIST_RING_SPINS 64 // Times a blocking MPMC push or pop backs off and retries before yielding the CPU
+
+/* struct llist_ring_slot is a single entry in a ring - like a list entry it points at data rather than holding it */
+struct llist_ring_slot {
+    void *data;
+    size_t data_size;
+};
+
+/* struct llist_ring contains an array backed ring */
+struct llist_ring {
+    _Atomic(uint32_t) locked; // Spin lock, taken around every operation while use_lock is set
+    bool use_lock; // Set if USE_LOCK is defined, cleared with ring_container_set_lock for rings used by one thread
+    uint64_t head; // Counter of the oldest entry, the next one popped
+    uint64_t tail; // Counter of the next entry pushed
+    size_t mask; // Capacity - 1, masks a counter down to its slot
+    struct llist_ring_slot *slots; // Capacity slots
+};
+
+struct llist_ring *ring_container_new(size_t capacity);
+void ring_container_free(struct llist_ring *ring, bool free_data);
+int ring_container_set_lock(struct llist_ring *ring, bool use_lock);
+size_t llist_ring_entries(struct llist_ring *ring);
+int llist_ring_push(struct llist_ring *ring, void *data, size_t d_size);
+int llist_ring_pop(struct llist_ring *ring, void **data, size_t *d_size);
+int llist_ring_peek(struct llist_ring *ring, size_t index, void **data, size_t *d_size);
+long llist_ring_foreach(struct llist_ring *ring, bool (*fn)(struct llist_ring_slot *slot, void *arg), void *arg);
+int ring_set_from_array(struct llist_ring *ring, void *array_head, size_t entry_size, size_t n_entries);
+
+/* struct llist_spsc_ring contains a single producer, single consumer ring */
+struct llist_spsc_ring {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) head; // Counter of the next entry popped, written by the consumer only
+    uint64_t tail_cache; // Consumer's copy of tail as last read
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) tail; // Counter of the next entry pushed, written by the producer only
+    uint64_t head_cache; // Producer's copy of head as last read
+    _Alignas(LLIST_CACHE_LINE) size_t mask; // Capacity - 1, fixed once created
+    struct llist_ring_slot *slots; // Capacity slots
+};
+
+struct llist_spsc_ring *spsc_ring_new(size_t capacity);
+void spsc_ring_free(struct llist_spsc_ring *ring, bool free_data);
+size_t llist_spsc_push_many(struct llist_spsc_ring *ring, void **data, const size_t *d_sizes, size_t n);
+size_t llist_spsc_pop_many(struct llist_spsc_ring *ring, void **data, size_t *d_sizes, size_t n);
+
+/* struct llist_mpmc_slot is a single entry in a multi producer, multi consumer ring */
+struct llist_mpmc_slot {
+    _Atomic(uint64_t) seq; // Position this slot can next be pushed at, or that position + 1 once it has been filled
+    void *data;
+    size_t data_size;
+};
+
+/* struct llist_mpmc_ring contains a multi producer, multi consumer ring */
+struct llist_mpmc_ring {
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) tail; // Next position a producer will claim
+    _Alignas(LLIST_CACHE_LINE) _Atomic(uint64_t) head; // Next position a consumer will claim
+    _Alignas(LLIST_CACHE_LINE) size_t mask; // Capacity - 1, fixed once created
+    struct llist_mpmc_slot *slots; // Capacity slots
+};
+
+struct llist_mpmc_ring *mpmc_ring_new(size_t capacity);
+void mpmc_ring_free(struct llist_mpmc_ring *ring, bool free_data);
+int llist_mpmc_try_push(struct llist_mpmc_ring *ring, void *data, size_t d_size);
+int llist_mpmc_try_pop(struct llist_mpmc_ring *ring, void **data, size_t *d_size);
+void llist_mpmc_push(struct llist_mpmc_ring *ring, void *data, size_t d_size);
+void llist_mpmc_pop(struct llist_mpmc_ring *ring, void **data, size_t *d_size);
+
+/* llist_ring_capacity returns the number of entries a ring holds before pushes start overwriting */
+static inline size_t llist_ring_capacity(struct llist_ring *ring) {
+    return ring->mask + 1;
+}
+
+/* llist_spsc_push adds an entry pointing at data to the ring.  Only the producer thread may call this.
+ Returns -1 if the ring is full */
+static inline int llist_spsc_push(struct llist_spsc_ring *ring, void *data, size_t d_size) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if(tail - ring->head_cache > ring->mask) {
+        // Acquire pairs with the release in llist_spsc_pop, so the consumer is done with the slot we reuse
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(tail - ring->head_cache > ring->mask)
+            return -1;
+    }
+    struct llist_ring_slot *slot = &ring->slots[tail & ring->mask];
+    slot->data = data;
+    slot->data_size = d_size;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/* llist_spsc_pop removes the oldest entry from the ring, returning its data through data and d_size.  Only the
+ consumer thread may call this.  Returns -1 if the ring is empty */
+static inline int llist_spsc_pop(struct llist_spsc_ring *ring, void **data, size_t *d_size) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if(head == ring->tail_cache) {
+        // Acquire pairs with the release in llist_spsc_push, so the slot is filled in before we read it
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if(head == ring->tail_cache)
+            return -1;
+    }
+    struct llist_ring_slot *slot = &ring->slots[head & ring->mask];
+    if(data)
+        *data = slot->data;
+    if(d_size)
+        *d_size = slot->data_size;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 0;
+}
+
+#endif /* ring_h */
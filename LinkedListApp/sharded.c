@@ -0,0 +1,143 @@
+//
+//  sharded.c
+//  LinkedListApp
+//
+//  Sharded container - routing items to shards and walking every shard in turn.
+//
+
+#include <stdio.h>
+#include "sharded.h"
+
+/* struct llist_sharded_walk carries a caller's callback through llist_foreach on each shard, noting whether it
+ asked to stop so the walk doesn't carry on into the next shard */
+struct llist_sharded_walk {
+    bool (*fn)(struct llist *node, void *arg);
+    void *arg;
+    bool stopped;
+};
+
+/* llist_sharded_visit is the llist_foreach callback used by llist_sharded_foreach */
+static bool llist_sharded_visit(struct llist *node, void *arg) {
+    struct llist_sharded_walk *walk = arg;
+    if(walk->fn(node, walk->arg))
+        return true;
+    walk->stopped = true;
+    return false;
+}
+
+/* sharded_container_new creates a sharded container split into n_shards indexed containers, or
+ LLIST_SHARDS_DEFAULT if n_shards is 0.  Roughly one shard per thread working on the container, rounded up,
+ keeps collisions on a shard lock rare.  Returns NULL on failure */
+struct llist_sharded_container *sharded_container_new(size_t n_shards) {
+    if(n_shards == 0)
+        n_shards = LLIST_SHARDS_DEFAULT;
+    if(n_shards > LLIST_SHARDS_MAX) {
+        printf("Too many shards requested, maximum is %d\n", LLIST_SHARDS_MAX);
+        return NULL;
+    }
+    struct llist_sharded_container *sc = calloc(1, sizeof(struct llist_sharded_container));
+    if(!sc)
+        return NULL;
+    sc->shards = calloc(n_shards, sizeof(struct llist_container *));
+    if(!sc->shards) {
+        free(sc);
+        return NULL;
+    }
+    sc->n_shards = n_shards;
+    for(size_t i = 0; i < n_shards; i++) {
+        sc->shards[i] = container_new_indexed();
+        if(!sc->shards[i]) {
+            printf("Failed allocating shard %zu\n", i);
+            sharded_container_free(sc, false);
+            return NULL;
+        }
+    }
+    return sc;
+}
+
+/* sharded_container_free frees every shard and the sharded container itself, freeing the data in every entry too
+ if free_data is true */
+void sharded_container_free(struct llist_sharded_container *sc, bool free_data) {
+    if(!sc)
+        return;
+    for(size_t i = 0; i < sc->n_shards; i++)
+        container_free(sc->shards[i], free_data);
+    free(sc->shards);
+    free(sc);
+}
+
+/* sharded_container_set_lock_type selects how threads wait for the lock of every shard.  This must be called while
+ no other thread is using the container */
+int sharded_container_set_lock_type(struct llist_sharded_container *sc, enum llist_lock_type lock_type) {
+    if(!sc)
+        return -1;
+    for(size_t i = 0; i < sc->n_shards; i++) {
+        if(container_set_lock_type(sc->shards[i], lock_type) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* sharded_container_entries returns the number of entries across every shard.  Shards being modified while this
+ runs may be counted before or after the change */
+size_t sharded_container_entries(struct llist_sharded_container *sc) {
+    size_t entries = 0;
+    if(!sc)
+        return 0;
+    for(size_t i = 0; i < sc->n_shards; i++)
+        entries += sc->shards[i]->list_entries;
+    return entries;
+}
+
+/* llist_sharded_add_data adds a new entry holding data to the shard its hash routes to */
+int llist_sharded_add_data(struct llist_sharded_container *sc, void *data, size_t d_size) {
+    if(!sc || !data || d_size == 0)
+        return -1;
+    return llist_add_tail_data(llist_shard_for(sc, XXH3_64bits(data, d_size)), data, d_size);
+}
+
+/* llist_sharded_find returns an entry whose data matches data, or NULL if there isn't one.  Only the shard data
+ routes to is searched.  The entry is protected exactly as for llist_find on that shard */
+struct llist *llist_sharded_find(struct llist_sharded_container *sc, const void *data, size_t d_size) {
+    if(!sc || !data || d_size == 0)
+        return NULL;
+    uint64_t hash = XXH3_64bits(data, d_size);
+    return llist_find_hashed(llist_shard_for(sc, hash), data, d_size, hash);
+}
+
+/* llist_sharded_delete_node deletes an entry found with llist_sharded_find or llist_sharded_foreach, freeing its
+ data too if free_data is true.  The entry is routed back to its shard by its data, so the data must not have been
+ changed since it was added */
+int llist_sharded_delete_node(struct llist_sharded_container *sc, struct llist *node, bool free_data) {
+    if(!sc || !node || !node->data || node->data_size == 0)
+        return -1;
+    return llist_delete_node(llist_shard_for(sc, llist_node_hash(node)), node, free_data);
+}
+
+/* llist_sharded_delete_data deletes an entry holding data, freeing the data too if free_data is true.
+ Returns -1 if no entry holds data.  The entry is found and unlinked under one acquisition of the shard lock, so
+ threads deleting the same data at once never both get hold of the same entry */
+int llist_sharded_delete_data(struct llist_sharded_container *sc, const void *data, size_t d_size, bool free_data) {
+    if(!sc || !data || d_size == 0)
+        return -1;
+    uint64_t hash = XXH3_64bits(data, d_size);
+    return llist_delete_data_hashed(llist_shard_for(sc, hash), data, d_size, hash, free_data);
+}
+
+/* llist_sharded_foreach calls fn on every entry in every shard, one shard after another, stopping early if fn
+ returns false.  Each shard is only locked for reading while it is being walked, so there is no point at which the
+ whole container is frozen - an entry added to a shard already walked is missed.  Entries come out grouped by shard
+ in no useful order.  Returns the number of entries visited, or -1 */
+long llist_sharded_foreach(struct llist_sharded_container *sc, bool (*fn)(struct llist *node, void *arg), void *arg) {
+    struct llist_sharded_walk walk = { .fn = fn, .arg = arg, .stopped = false };
+    long visited = 0;
+    if(!sc || !fn)
+        return -1;
+    for(size_t i = 0; i < sc->n_shards && !walk.stopped; i++) {
+        int n = llist_foreach(sc->shards[i], llist_sharded_visit, &walk);
+        if(n < 0)
+            return -1;
+        visited += n;
+    }
+    return visited;
+}
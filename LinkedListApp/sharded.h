@@ -0,0 +1,51 @@
+//
+//  sharded.h
+//  LinkedListApp
+//
+//  Sharded container - a set of independent indexed containers with every item routed to one of them by the hash
+//  of its data.  Each shard has its own lock, list, node pool and hash index, so threads working on different items
+//  mostly land on different shards and stop fighting over the same lock and cache lines.  Lookups, adds and deletes
+//  of an item only ever touch the one shard that item hashes to.
+//
+
+#ifndef sharded_h
+#define sharded_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "list.h"
+
+#define LLIST_SHARDS_DEFAULT 16 // Shards created when no shard count is given
+#define LLIST_SHARDS_MAX 4096 // Most shards a sharded container can be split into
+
+/* struct llist_sharded_container contains a set of shards, each an ordinary indexed container */
+struct llist_sharded_container {
+    struct llist_container **shards; // One container per shard
+    size_t n_shards; // Number of shards, fixed once created
+};
+
+struct llist_sharded_container *sharded_container_new(size_t n_shards);
+void sharded_container_free(struct llist_sharded_container *sc, bool free_data);
+int sharded_container_set_lock_type(struct llist_sharded_container *sc, enum llist_lock_type lock_type);
+size_t sharded_container_entries(struct llist_sharded_container *sc);
+int llist_sharded_add_data(struct llist_sharded_container *sc, void *data, size_t d_size);
+struct llist *llist_sharded_find(struct llist_sharded_container *sc, const void *data, size_t d_size);
+int llist_sharded_delete_node(struct llist_sharded_container *sc, struct llist *node, bool free_data);
+int llist_sharded_delete_data(struct llist_sharded_container *sc, const void *data, size_t d_size, bool free_data);
+long llist_sharded_foreach(struct llist_sharded_container *sc, bool (*fn)(struct llist *node, void *arg), void *arg);
+
+/* llist_shard_index maps a data hash onto a shard.  The hash is remixed first - the shard hash indexes use the top
+ bits of the same hash to pick their stripes and the low bits for their tags, so routing on those bits directly
+ would leave every entry in a shard sharing them */
+static inline size_t llist_shard_index(struct llist_sharded_container *sc, uint64_t hash) {
+    uint64_t mixed = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(((mixed >> 32) * sc->n_shards) >> 32);
+}
+
+/* llist_shard_for returns the shard that entries holding data with this hash belong to */
+static inline struct llist_container *llist_shard_for(struct llist_sharded_container *sc, uint64_t hash) {
+    return sc->shards[llist_shard_index(sc, hash)];
+}
+
+#endif /* sharded_h */
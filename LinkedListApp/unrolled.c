@@ -0,0 +1,316 @@
+//
+//  unrolled.c
+//  LinkedListApp
+//
+//  Unrolled linked list - node splitting and merging, and the head, tail and current position operations.
+//
+
+#include <stdio.h>
+#include "list.h"
+#include "unrolled.h"
+
+#ifdef USE_LOCK
+#define UNROLLED_LOCK(cont) llist_spin_lock(&(cont)->locked)
+#define UNROLLED_UNLOCK(cont) llist_spin_unlock(&(cont)->locked)
+#else
+#define UNROLLED_LOCK(cont) ({})
+#define UNROLLED_UNLOCK(cont) ({})
+#endif
+
+/* unrolled_container_new creates an empty unrolled list of record_size byte records, with nodes node_lines cache
+ lines long - or LLIST_UNROLLED_LINES if node_lines is 0.  Returns NULL if a node that size can't hold at least
+ two records */
+struct llist_unrolled_container *unrolled_container_new(size_t record_size, size_t node_lines) {
+    if(node_lines == 0)
+        node_lines = LLIST_UNROLLED_LINES;
+    if(record_size == 0 || node_lines > LLIST_UNROLLED_MAX_LINES) {
+        printf("Invalid unrolled list record size or node size\n");
+        return NULL;
+    }
+    size_t node_size = node_lines * LLIST_CACHE_LINE;
+    size_t capacity = (node_size - offsetof(struct llist_unrolled_node, records)) / record_size;
+    if(capacity < 2) {
+        printf("Records of %zu bytes don't fit %zu cache line nodes\n", record_size, node_lines);
+        return NULL;
+    }
+    struct llist_unrolled_container *new = calloc(1, sizeof(struct llist_unrolled_container));
+    if(!new)
+        return NULL;
+    atomic_init(&new->locked, LLIST_LOCK_FREE);
+    new->record_size = record_size;
+    new->node_capacity = capacity;
+    new->node_size = node_size;
+    return new;
+}
+
+/* unrolled_container_free frees an unrolled list along with every record in it */
+void unrolled_container_free(struct llist_unrolled_container *cont) {
+    struct llist_unrolled_node *node, *next;
+    if(!cont)
+        return;
+    for(node = cont->head; node; node = next) {
+        next = node->next;
+        free(node);
+    }
+    free(cont);
+}
+
+/* llist_unrolled_node_new allocates an empty, unlinked node */
+static struct llist_unrolled_node *llist_unrolled_node_new(struct llist_unrolled_container *cont) {
+    struct llist_unrolled_node *node = aligned_alloc(LLIST_CACHE_LINE, cont->node_size);
+    if(!node)
+        return NULL;
+    node->next = node->prev = NULL;
+    node->count = 0;
+    return node;
+}
+
+/* llist_unrolled_link_after links node into the list after prev, or in as the head if prev is NULL */
+static void llist_unrolled_link_after(struct llist_unrolled_container *cont, struct llist_unrolled_node *prev,
+                                      struct llist_unrolled_node *node) {
+    node->prev = prev;
+    node->next = prev ? prev->next : cont->head;
+    if(node->next)
+        node->next->prev = node;
+    else
+        cont->tail = node;
+    if(prev)
+        prev->next = node;
+    else
+        cont->head = node;
+}
+
+/* llist_unrolled_unlink takes a node out of the list and frees it */
+static void llist_unrolled_unlink(struct llist_unrolled_container *cont, struct llist_unrolled_node *node) {
+    if(node->prev)
+        node->prev->next = node->next;
+    else
+        cont->head = node->next;
+    if(node->next)
+        node->next->prev = node->prev;
+    else
+        cont->tail = node->prev;
+    free(node);
+}
+
+/* llist_unrolled_insert copies record into node at index pos, moving later records up one.  A full node is split
+ first, half its records moving to a new node after it.  The current position is kept on the record it was on.
+ Returns the node the record ended up in with its index in *pos, or NULL on failure */
+static struct llist_unrolled_node *llist_unrolled_insert(struct llist_unrolled_container *cont,
+                                                         struct llist_unrolled_node *node, uint32_t *pos,
+                                                         const void *record) {
+    if(node->count == cont->node_capacity) {
+        struct llist_unrolled_node *split = llist_unrolled_node_new(cont);
+        if(!split)
+            return NULL;
+        uint32_t half = node->count / 2;
+        split->count = node->count - half;
+        memcpy(split->records, llist_unrolled_record(cont, node, half), split->count * cont->record_size);
+        node->count = half;
+        llist_unrolled_link_after(cont, node, split);
+        if(cont->list == node && cont->list_pos >= half) {
+            cont->list = split;
+            cont->list_pos -= half;
+        }
+        if(*pos > half) {
+            node = split;
+            *pos -= half;
+        }
+    }
+    memmove(llist_unrolled_record(cont, node, *pos + 1), llist_unrolled_record(cont, node, *pos),
+            (node->count - *pos) * cont->record_size);
+    memcpy(llist_unrolled_record(cont, node, *pos), record, cont->record_size);
+    node->count++;
+    if(cont->list == node && cont->list_pos >= *pos)
+        cont->list_pos++;
+    cont->list_entries++;
+    return node;
+}
+
+/* llist_unrolled_merge folds node into a neighbour once it has dropped below half full, if the two fit in one node.
+ The current position is kept on the record it was on */
+static void llist_unrolled_merge(struct llist_unrolled_container *cont, struct llist_unrolled_node *node) {
+    struct llist_unrolled_node *into, *from;
+    if(node->count >= cont->node_capacity / 2)
+        return;
+    if(node->next && node->count + node->next->count <= cont->node_capacity) {
+        into = node;
+        from = node->next;
+    } else if(node->prev && node->prev->count + node->count <= cont->node_capacity) {
+        into = node->prev;
+        from = node;
+    } else {
+        return;
+    }
+    memcpy(llist_unrolled_record(cont, into, into->count), from->records, from->count * cont->record_size);
+    if(cont->list == from) {
+        cont->list = into;
+        cont->list_pos += into->count;
+    }
+    into->count += from->count;
+    llist_unrolled_unlink(cont, from);
+}
+
+/* llist_unrolled_add_head adds a copy of record to the start of the list.  When the head node is full a new node is
+ started rather than the head being split, so records added one after another pack nodes full */
+int llist_unrolled_add_head(struct llist_unrolled_container *cont, const void *record) {
+    uint32_t pos = 0;
+    if(!cont || !record)
+        return -1;
+    UNROLLED_LOCK(cont);
+    if(!cont->head || cont->head->count == cont->node_capacity) {
+        struct llist_unrolled_node *node = llist_unrolled_node_new(cont);
+        if(!node) {
+            UNROLLED_UNLOCK(cont);
+            return -1;
+        }
+        llist_unrolled_link_after(cont, NULL, node);
+    }
+    llist_unrolled_insert(cont, cont->head, &pos, record);
+    UNROLLED_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_unrolled_add_tail adds a copy of record to the end of the list, starting a new node when the tail is full */
+int llist_unrolled_add_tail(struct llist_unrolled_container *cont, const void *record) {
+    if(!cont || !record)
+        return -1;
+    UNROLLED_LOCK(cont);
+    if(!cont->tail || cont->tail->count == cont->node_capacity) {
+        struct llist_unrolled_node *node = llist_unrolled_node_new(cont);
+        if(!node) {
+            UNROLLED_UNLOCK(cont);
+            return -1;
+        }
+        llist_unrolled_link_after(cont, cont->tail, node);
+    }
+    uint32_t pos = cont->tail->count;
+    llist_unrolled_insert(cont, cont->tail, &pos, record);
+    UNROLLED_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_unrolled_add_current inserts a copy of record before the current record and makes it the current record.
+ If the current position has moved past the end of the list the record is added to the tail */
+int llist_unrolled_add_current(struct llist_unrolled_container *cont, const void *record) {
+    struct llist_unrolled_node *node;
+    uint32_t pos;
+    if(!cont || !record)
+        return -1;
+    UNROLLED_LOCK(cont);
+    if(cont->list) {
+        pos = cont->list_pos;
+        node = llist_unrolled_insert(cont, cont->list, &pos, record);
+    } else {
+        if(!cont->tail || cont->tail->count == cont->node_capacity) {
+            node = llist_unrolled_node_new(cont);
+            if(!node) {
+                UNROLLED_UNLOCK(cont);
+                return -1;
+            }
+            llist_unrolled_link_after(cont, cont->tail, node);
+        }
+        pos = cont->tail->count;
+        node = llist_unrolled_insert(cont, cont->tail, &pos, record);
+    }
+    if(!node) {
+        UNROLLED_UNLOCK(cont);
+        return -1;
+    }
+    cont->list = node;
+    cont->list_pos = pos;
+    UNROLLED_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_unrolled_delete_current deletes the current record, moving the current position on to the record after
+ it.  Returns -1 if there is no current record */
+int llist_unrolled_delete_current(struct llist_unrolled_container *cont) {
+    if(!cont)
+        return -1;
+    UNROLLED_LOCK(cont);
+    struct llist_unrolled_node *node = cont->list;
+    if(!node) {
+        UNROLLED_UNLOCK(cont);
+        return -1;
+    }
+    uint32_t pos = cont->list_pos;
+    memmove(llist_unrolled_record(cont, node, pos), llist_unrolled_record(cont, node, pos + 1),
+            (node->count - pos - 1) * cont->record_size);
+    node->count--;
+    cont->list_entries--;
+    if(pos == node->count) {
+        cont->list = node->next;
+        cont->list_pos = 0;
+    }
+    if(node->count == 0)
+        llist_unrolled_unlink(cont, node);
+    else
+        llist_unrolled_merge(cont, node);
+    UNROLLED_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_unrolled_get_current copies the current record into record.  Returns -1 if there is no current record */
+int llist_unrolled_get_current(struct llist_unrolled_container *cont, void *record) {
+    if(!cont || !record)
+        return -1;
+    UNROLLED_LOCK(cont);
+    if(!cont->list) {
+        UNROLLED_UNLOCK(cont);
+        return -1;
+    }
+    memcpy(record, llist_unrolled_record(cont, cont->list, cont->list_pos), cont->record_size);
+    UNROLLED_UNLOCK(cont);
+    return 0;
+}
+
+/* llist_unrolled_rewind moves the current position to the first record.  Returns -1 if the list is empty */
+int llist_unrolled_rewind(struct llist_unrolled_container *cont) {
+    if(!cont)
+        return -1;
+    UNROLLED_LOCK(cont);
+    cont->list = cont->head;
+    cont->list_pos = 0;
+    int ret = cont->list ? 0 : -1;
+    UNROLLED_UNLOCK(cont);
+    return ret;
+}
+
+/* llist_unrolled_next moves the current position on to the next record.  Returns -1 once it moves past the end */
+int llist_unrolled_next(struct llist_unrolled_container *cont) {
+    if(!cont)
+        return -1;
+    UNROLLED_LOCK(cont);
+    if(cont->list && ++cont->list_pos == cont->list->count) {
+        cont->list = cont->list->next;
+        cont->list_pos = 0;
+    }
+    int ret = cont->list ? 0 : -1;
+    UNROLLED_UNLOCK(cont);
+    return ret;
+}
+
+/* llist_unrolled_foreach calls fn on every record from head to tail, stopping early if fn returns false.  fn is
+ handed a pointer to the record in place and must not add or delete records.  Returns the number of records
+ visited, or -1 */
+long llist_unrolled_foreach(struct llist_unrolled_container *cont, bool (*fn)(void *record, void *arg), void *arg) {
+    long visited = 0;
+    if(!cont || !fn)
+        return -1;
+    UNROLLED_LOCK(cont);
+    for(struct llist_unrolled_node *node = cont->head; node; node = node->next) {
+        // Start pulling in the next node while we work through this one
+        if(node->next)
+            __builtin_prefetch(node->next);
+        for(uint32_t i = 0; i < node->count; i++) {
+            visited++;
+            if(!fn(llist_unrolled_record(cont, node, i), arg)) {
+                UNROLLED_UNLOCK(cont);
+                return visited;
+            }
+        }
+    }
+    UNROLLED_UNLOCK(cont);
+    return visited;
+}
@@ -0,0 +1,64 @@
+//
+//  unrolled.h
+//  LinkedListApp
+//
+//  Unrolled linked list - a list of fixed size records where each node holds as many records as fit in one to
+//  LLIST_UNROLLED_MAX_LINES cache lines, copied in rather than pointed at.  An ordinary list pays two pointers and
+//  a data pointer and size for every item, and a cache miss for every step of a scan.  Here the per node overhead
+//  is shared between every record in the node, and a scan walks records sitting next to each other in memory.
+//  A node that fills up is split in two, and a node that drops below half full is merged with its neighbour, so
+//  nodes stay at least half full however records are added and deleted.
+//
+
+#ifndef unrolled_h
+#define unrolled_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lock.h"
+
+#define LLIST_UNROLLED_LINES 2 // Cache lines per node when none are asked for
+#define LLIST_UNROLLED_MAX_LINES 4 // Most cache lines a node can take up
+
+/* struct llist_unrolled_node is a node in an unrolled list, allocated cache line aligned along with its records */
+struct llist_unrolled_node {
+    struct llist_unrolled_node *next; // Next node in the list
+    struct llist_unrolled_node *prev; // Previous node in the list
+    uint32_t count; // Records in use, always the first count slots of records
+    unsigned char records[] __attribute__((aligned(8))); // Room for the container's node_capacity records
+};
+
+/* struct llist_unrolled_container contains an unrolled list.  Like the list pointer of an ordinary container the
+ current position is shared by everything using the container */
+struct llist_unrolled_container {
+    struct llist_unrolled_node *head; // First node, NULL if the list is empty
+    struct llist_unrolled_node *tail; // Last node
+    struct llist_unrolled_node *list; // Node holding the current record, NULL once moved past the end
+    uint32_t list_pos; // Index of the current record within list
+    size_t list_entries; // Records in the list
+    size_t record_size; // Size of every record, fixed once created
+    size_t node_capacity; // Records each node can hold
+    size_t node_size; // Bytes allocated per node, a whole number of cache lines
+    _Atomic(uint32_t) locked; // Spin lock, taken around every operation if USE_LOCK is defined
+};
+
+struct llist_unrolled_container *unrolled_container_new(size_t record_size, size_t node_lines);
+void unrolled_container_free(struct llist_unrolled_container *cont);
+int llist_unrolled_add_head(struct llist_unrolled_container *cont, const void *record);
+int llist_unrolled_add_tail(struct llist_unrolled_container *cont, const void *record);
+int llist_unrolled_add_current(struct llist_unrolled_container *cont, const void *record);
+int llist_unrolled_delete_current(struct llist_unrolled_container *cont);
+int llist_unrolled_get_current(struct llist_unrolled_container *cont, void *record);
+int llist_unrolled_rewind(struct llist_unrolled_container *cont);
+int llist_unrolled_next(struct llist_unrolled_container *cont);
+long llist_unrolled_foreach(struct llist_unrolled_container *cont, bool (*fn)(void *record, void *arg), void *arg);
+
+/* llist_unrolled_record returns a pointer to record index of a node */
+static inline void *llist_unrolled_record(struct llist_unrolled_container *cont, struct llist_unrolled_node *node,
+                                          size_t index) {
+    return node->records + index * cont->record_size;
+}
+
+#endif /* unrolled_h */
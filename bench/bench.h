@@ -0,0 +1,56 @@
+//
+//  bench.h
+//  LinkedListApp
+//
+//  Helpers shared by the benchmark and stress programs.  Every benchmark takes an optional scale as its first
+//  argument - 1 is a quick run for make check, and with no argument it runs at full size.  Anything a program
+//  measures it also checks, and a failed check exits with a non zero status.
+//
+
+#ifndef bench_h
+#define bench_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_FULL 100 // Scale benchmarks run at when none is given
+
+/* BENCH_CHECK exits the program if cond doesn't hold */
+#define BENCH_CHECK(cond) ({ \
+    if(!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+})
+
+/* bench_now returns a monotonic timestamp in seconds */
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* bench_scale returns the scale given as the first argument, or BENCH_FULL */
+static inline size_t bench_scale(int argc, char **argv) {
+    size_t scale = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_FULL;
+    return scale ? scale : 1;
+}
+
+/* bench_report prints the time per operation and throughput of ops operations that took secs seconds */
+static inline void bench_report(const char *name, size_t ops, double secs) {
+    printf("%-48s %10.1f ns/op %10.2f Mops/s\n", name, secs * 1e9 / ops, ops / secs / 1e6);
+    fflush(stdout);
+}
+
+/* bench_rand is a xorshift generator - cheap enough not to show up in what is being measured */
+static inline uint64_t bench_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+#endif /* bench_h */
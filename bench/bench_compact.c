@@ -0,0 +1,115 @@
+//
+//  bench_compact.c
+//  LinkedListApp
+//
+//  Compact list against struct llist - building each from the tail, scanning every entry, then scanning again
+//  after random deletes and re-adds have scattered the list order across the nodes.  Bytes per entry counts the
+//  node array and size array of the compact list, including room grown but not yet used, against the slab node
+//  size of the llist, to show what 32 bit links save over pointers.  Every scan has to add up to what went in.
+//
+
+#include "list.h"
+#include "compact.h"
+#include "bench.h"
+
+/* bench_compact_add is the llist_compact_foreach callback adding up the values entries point at */
+static bool bench_compact_add(void *data, size_t d_size, void *arg) {
+    (void)d_size;
+    *(uint64_t *)arg += *(uint64_t *)data;
+    return true;
+}
+
+/* bench_llist_add is the llist_foreach callback adding up the values entries point at */
+static bool bench_llist_add(struct llist *node, void *arg) {
+    *(uint64_t *)arg += *(uint64_t *)node->data;
+    return true;
+}
+
+/* bench_report_bytes prints bytes per entry */
+static void bench_report_bytes(const char *name, size_t bytes, size_t n) {
+    printf("%-48s %10.1f bytes/entry\n", name, (double)bytes / n);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    size_t n = 10000 * bench_scale(argc, argv), rounds = 20;
+    uint64_t *values = malloc(n * sizeof(uint64_t));
+    uint32_t *indices = malloc(n * sizeof(uint32_t));
+    struct llist **nodes = malloc(n * sizeof(struct llist *));
+    uint64_t expect = 0, sum, seed = 0x853C49E6748FEA9BULL;
+    BENCH_CHECK(values && indices && nodes);
+    for(size_t i = 0; i < n; i++)
+        expect += values[i] = i * 7 + 1;
+
+    // Compact - grown from nothing, so the arrays double their way up through realloc
+    struct llist_compact_container *compact = compact_container_new(0);
+    BENCH_CHECK(compact);
+    double start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        indices[i] = llist_compact_add_tail(compact, &values[i], sizeof(uint64_t));
+        BENCH_CHECK(indices[i] != LLIST_COMPACT_NIL);
+    }
+    bench_report("compact: build", n, bench_now() - start);
+    // A node and its size, kept in separate arrays
+    size_t per_node = sizeof(struct llist_compact_node) + sizeof(uint32_t);
+    bench_report_bytes("compact: memory", compact->n_nodes * per_node, n);
+    bench_report_bytes("compact: memory, entries in use only", compact->list_entries * per_node, n);
+    start = bench_now();
+    for(size_t r = 0; r < rounds; r++) {
+        sum = 0;
+        BENCH_CHECK(llist_compact_foreach(compact, bench_compact_add, &sum) == (long)n && sum == expect);
+    }
+    bench_report("compact: scan", n * rounds, bench_now() - start);
+    start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        size_t k = bench_rand(&seed) % n;
+        BENCH_CHECK(llist_compact_delete(compact, indices[k], false) == 0);
+        indices[k] = llist_compact_add_tail(compact, &values[k], sizeof(uint64_t));
+        BENCH_CHECK(indices[k] != LLIST_COMPACT_NIL);
+    }
+    bench_report("compact: delete + add", n, bench_now() - start);
+    start = bench_now();
+    for(size_t r = 0; r < rounds; r++) {
+        sum = 0;
+        BENCH_CHECK(llist_compact_foreach(compact, bench_compact_add, &sum) == (long)n && sum == expect);
+    }
+    bench_report("compact: scan after churn", n * rounds, bench_now() - start);
+    compact_container_free(compact, false);
+
+    // struct llist - nodes carved out of the container's slabs
+    struct llist_container *cont = container_new();
+    BENCH_CHECK(cont);
+    seed = 0x853C49E6748FEA9BULL;
+    start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+        nodes[i] = cont->tail;
+    }
+    bench_report("llist: build", n, bench_now() - start);
+    bench_report_bytes("llist: memory", n * cont->pool.node_size, n);
+    start = bench_now();
+    for(size_t r = 0; r < rounds; r++) {
+        sum = 0;
+        BENCH_CHECK(llist_foreach(cont, bench_llist_add, &sum) == (int)n && sum == expect);
+    }
+    bench_report("llist: scan", n * rounds, bench_now() - start);
+    start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        size_t k = bench_rand(&seed) % n;
+        BENCH_CHECK(llist_delete_node(cont, nodes[k], false) == 0);
+        BENCH_CHECK(llist_add_tail_data(cont, &values[k], sizeof(uint64_t)) == 0);
+        nodes[k] = cont->tail;
+    }
+    bench_report("llist: delete + add", n, bench_now() - start);
+    start = bench_now();
+    for(size_t r = 0; r < rounds; r++) {
+        sum = 0;
+        BENCH_CHECK(llist_foreach(cont, bench_llist_add, &sum) == (int)n && sum == expect);
+    }
+    bench_report("llist: scan after churn", n * rounds, bench_now() - start);
+    container_free(cont, false);
+    free(nodes);
+    free(indices);
+    free(values);
+    return 0;
+}
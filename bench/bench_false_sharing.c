@@ -0,0 +1,152 @@
+//
+//  bench_false_sharing.c
+//  LinkedListApp
+//
+//  Container layout - reader threads do lock free index lookups while a writer thread takes and releases the lock
+//  as fast as it can.  Readers only load h_map and the flags next to it, so with the lock word on its own cache
+//  line the writer shouldn't slow them down.  The same loop is run against a struct packing the index pointer and
+//  the lock into one line, as the container used to, to show what the split saves.  Cache misses are counted with
+//  perf_event_open where the kernel lets us, otherwise only the times are reported.  Every lookup has to succeed.
+//
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "list.h"
+#include "epoch.h"
+#include "bench.h"
+
+#define BENCH_READERS 3
+#define BENCH_KEYS 1024
+
+/* struct bench_packed keeps the index pointer and the lock on one cache line */
+struct bench_packed {
+    _Alignas(LLIST_CACHE_LINE) struct llist_map *_Atomic h_map;
+    _Atomic(uint32_t) locked;
+};
+
+struct bench_fs_arg {
+    struct llist_map *_Atomic *h_map; // Index pointer the readers load before every lookup
+    _Atomic(uint32_t) *locked; // Lock word the writer hammers
+    _Atomic(bool) *stop;
+    uint64_t *keys;
+    size_t ops;
+};
+
+static uint64_t keys[BENCH_KEYS];
+
+/* bench_fs_match is the hash_map_match_fn for the benchmark keys */
+static bool bench_fs_match(void *entry, uint64_t hash, const void *data, size_t d_size) {
+    (void)hash;
+    struct llist *node = entry;
+    return node->data_size == d_size && !memcmp(node->data, data, d_size);
+}
+
+/* bench_fs_reader looks keys up through whichever index pointer it was given, reloading it every time */
+static void *bench_fs_reader(void *p) {
+    struct bench_fs_arg *arg = p;
+    uint64_t state = (uintptr_t)p | 1;
+    for(size_t i = 0; i < arg->ops; i++) {
+        uint64_t *key = &keys[bench_rand(&state) % BENCH_KEYS];
+        BENCH_CHECK(llist_epoch_enter() == 0);
+        struct llist_map *map = atomic_load_explicit(arg->h_map, memory_order_acquire);
+        BENCH_CHECK(hash_map_find(map, XXH3_64bits(key, sizeof(uint64_t)), bench_fs_match, key, sizeof(uint64_t)));
+        llist_epoch_exit();
+    }
+    return NULL;
+}
+
+/* bench_fs_writer takes and releases the lock until the readers are done */
+static void *bench_fs_writer(void *p) {
+    struct bench_fs_arg *arg = p;
+    while(!atomic_load_explicit(arg->stop, memory_order_relaxed)) {
+        llist_spin_lock(arg->locked);
+        llist_spin_unlock(arg->locked);
+    }
+    return NULL;
+}
+
+/* bench_fs_counter opens a cache miss counter covering this process and the threads it starts, or returns -1 */
+static int bench_fs_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* bench_fs_run times the readers against the given index pointer with the writer hammering locked alongside them
+ if writer is set, reporting cache misses per lookup if they can be counted */
+static void bench_fs_run(const char *name, struct llist_map *_Atomic *h_map, _Atomic(uint32_t) *locked, bool writer,
+                         size_t ops) {
+    pthread_t readers[BENCH_READERS], hammer;
+    _Atomic(bool) stop = false;
+    struct bench_fs_arg args[BENCH_READERS];
+    struct bench_fs_arg w_arg = { .h_map = h_map, .locked = locked, .stop = &stop };
+    uint64_t misses = 0;
+    int counter = bench_fs_counter();
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    if(writer)
+        BENCH_CHECK(pthread_create(&hammer, NULL, bench_fs_writer, &w_arg) == 0);
+    double start = bench_now();
+    for(int i = 0; i < BENCH_READERS; i++) {
+        args[i] = (struct bench_fs_arg){ .h_map = h_map, .ops = ops };
+        BENCH_CHECK(pthread_create(&readers[i], NULL, bench_fs_reader, &args[i]) == 0);
+    }
+    for(int i = 0; i < BENCH_READERS; i++)
+        pthread_join(readers[i], NULL);
+    double secs = bench_now() - start;
+    atomic_store(&stop, true);
+    if(writer)
+        pthread_join(hammer, NULL);
+    bench_report(name, ops * BENCH_READERS, secs);
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(counter, &misses, sizeof(misses)) == sizeof(misses))
+            printf("%-48s %10.2f misses/op\n", "", (double)misses / (ops * BENCH_READERS));
+        close(counter);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t ops = 20000 * bench_scale(argc, argv);
+    struct llist_container *cont = container_new_indexed();
+    BENCH_CHECK(cont);
+    // The point of the layout - nothing lookups read shares a line with the lock
+    BENCH_CHECK(offsetof(struct llist_container, h_map) / LLIST_CACHE_LINE !=
+                offsetof(struct llist_container, locked) / LLIST_CACHE_LINE);
+    BENCH_CHECK(offsetof(struct llist_container, indexed) / LLIST_CACHE_LINE !=
+                offsetof(struct llist_container, locked) / LLIST_CACHE_LINE);
+    for(size_t i = 0; i < BENCH_KEYS; i++) {
+        keys[i] = i * 2654435761u;
+        BENCH_CHECK(llist_add_tail_data(cont, &keys[i], sizeof(uint64_t)) == 0);
+    }
+    if(bench_fs_counter() < 0)
+        printf("Cache miss counters unavailable, reporting times only\n");
+
+    struct bench_packed *packed = aligned_alloc(LLIST_CACHE_LINE, sizeof(struct bench_packed));
+    BENCH_CHECK(packed);
+    atomic_init(&packed->h_map, cont->h_map);
+    atomic_init(&packed->locked, LLIST_LOCK_FREE);
+
+    bench_fs_run("container layout, readers alone", &cont->h_map, &cont->locked, false, ops);
+    bench_fs_run("container layout, writer hammering the lock", &cont->h_map, &cont->locked, true, ops);
+    bench_fs_run("packed line, readers alone", &packed->h_map, &packed->locked, false, ops);
+    bench_fs_run("packed line, writer hammering the lock", &packed->h_map, &packed->locked, true, ops);
+    BENCH_CHECK(atomic_load(&cont->locked) == LLIST_LOCK_FREE);
+    free(packed);
+    container_free(cont, false);
+    return 0;
+}
@@ -0,0 +1,46 @@
+//
+//  bench_grow.c
+//  LinkedListApp
+//
+//  Index growth - the latency of every single insert into an indexed container as its index grows from empty.
+//  Growing moves entries across a few slots per operation, so the worst insert should stay far below the time a
+//  full rehash takes, which is measured with hash_map_create on the finished list for comparison.
+//
+
+#include "list.h"
+#include "bench.h"
+
+/* bench_cmp orders latencies for qsort */
+static int bench_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    size_t n = 10000 * bench_scale(argc, argv);
+    uint64_t *values = malloc(n * sizeof(uint64_t));
+    double *lat = malloc(n * sizeof(double));
+    struct llist_container *cont = container_new_indexed();
+    BENCH_CHECK(values && lat && cont);
+    double total = 0;
+    for(size_t i = 0; i < n; i++) {
+        values[i] = i;
+        double start = bench_now();
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+        lat[i] = bench_now() - start;
+        total += lat[i];
+    }
+    for(size_t i = 0; i < n; i++)
+        BENCH_CHECK(llist_find(cont, &values[i], sizeof(uint64_t)) != NULL);
+    double start = bench_now();
+    BENCH_CHECK(hash_map_create(cont));
+    double rehash = bench_now() - start;
+    qsort(lat, n, sizeof(double), bench_cmp);
+    printf("%zu indexed inserts: mean %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.0f ns\n", n, total * 1e9 / n,
+           lat[n * 99 / 100] * 1e9, lat[n * 999 / 1000] * 1e9, lat[n - 1] * 1e9);
+    printf("full rehash of %zu entries: %.0f ns\n", n, rehash * 1e9);
+    container_free(cont, false);
+    free(lat);
+    free(values);
+    return 0;
+}
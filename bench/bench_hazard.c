@@ -0,0 +1,110 @@
+//
+//  bench_hazard.c
+//  LinkedListApp
+//
+//  Memory held back by a stalled reader.  One thread stalls while holding a reference into the container - inside
+//  an epoch critical section for an epoch container, or with one entry published as a hazard pointer for a hazard
+//  container - while another churns entries in and out.  Epochs can't move on past the stalled reader, so every
+//  deleted node stays in limbo and the pool keeps growing.  Hazard pointers only hold back the one entry the reader
+//  published, so the pool should stay a small bounded size however long the churn runs.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include "list.h"
+#include "bench.h"
+
+#define BENCH_LIVE 64 // Entries kept in the list while it churns
+
+struct bench_stall {
+    struct llist_container *cont;
+    uint64_t *value; // Data the reader looks up and holds
+    _Atomic(bool) holding; // Set once the reader holds its reference
+    _Atomic(bool) done; // Set once the churn is over and the reader can let go
+};
+
+/* bench_stalled_reader takes a reference into the container and sits on it until the churn is done */
+static void *bench_stalled_reader(void *p) {
+    struct bench_stall *stall = p;
+    bool hazard = stall->cont->reclaim == LLIST_RECLAIM_HAZARD;
+    if(!hazard)
+        BENCH_CHECK(llist_epoch_enter() == 0);
+    // For a hazard container the entry stays published in LLIST_HAZARD_FIND until it is cleared below
+    struct llist *node = llist_find(stall->cont, stall->value, sizeof(uint64_t));
+    BENCH_CHECK(node && node->data == stall->value);
+    atomic_store(&stall->holding, true);
+    while(!atomic_load(&stall->done))
+        sched_yield();
+    // The entry we hold must not have been reused under us
+    BENCH_CHECK(node->data == stall->value);
+    if(hazard)
+        llist_hazard_clear(LLIST_HAZARD_FIND);
+    else
+        llist_epoch_exit();
+    return NULL;
+}
+
+/* bench_held_nodes returns the number of nodes a container is holding on to, live or waiting to be reused.  With
+ USE_NODE_POOL that is everything allocated in its pool - without it deleted nodes are retired one by one, so it is
+ the live entries plus whatever this thread still has waiting to be freed */
+static size_t bench_held_nodes(struct llist_container *cont) {
+    size_t n = 0;
+#ifdef USE_NODE_POOL
+    for(struct llist_slab *slab = cont->pool.slabs; slab; slab = slab->next)
+        n += slab->n_nodes;
+#else
+    n = cont->list_entries;
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD)
+        n += llist_hazard_self ? llist_hazard_self->n_retired : 0;
+    else
+        n += llist_epoch_self ? llist_epoch_self->n_retired : 0;
+#endif
+    return n;
+}
+
+/* bench_churn adds and deletes churn entries with a stalled reader holding a reference, and returns how many nodes
+ the container ended up holding on to */
+static size_t bench_churn(enum llist_reclaim reclaim, size_t churn, uint64_t *values) {
+    pthread_t reader;
+    struct llist_container *cont = container_new();
+    BENCH_CHECK(cont && container_set_reclaim(cont, reclaim) == 0 && container_set_indexed(cont, true) == 0);
+    for(size_t i = 0; i < BENCH_LIVE; i++)
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+    struct bench_stall stall = { .cont = cont, .value = &values[BENCH_LIVE - 1] };
+    BENCH_CHECK(pthread_create(&reader, NULL, bench_stalled_reader, &stall) == 0);
+    while(!atomic_load(&stall.holding))
+        sched_yield();
+    double start = bench_now();
+    for(size_t i = 0; i < churn; i++) {
+        BENCH_CHECK(llist_delete_node(cont, cont->head, false) == 0);
+        BENCH_CHECK(llist_add_tail_data(cont, &values[BENCH_LIVE + i % BENCH_LIVE], sizeof(uint64_t)) == 0);
+    }
+    double secs = bench_now() - start;
+    size_t nodes = bench_held_nodes(cont);
+    atomic_store(&stall.done, true);
+    pthread_join(reader, NULL);
+    BENCH_CHECK(cont->list_entries == BENCH_LIVE);
+    printf("%-8s %9zu deletes with a stalled reader: %9zu nodes held (%zu KB), %.1f ns per delete + add\n",
+           reclaim == LLIST_RECLAIM_HAZARD ? "hazard" : "epoch", churn, nodes, nodes * cont->pool.node_size / 1024,
+           secs * 1e9 / churn);
+    fflush(stdout);
+    container_free(cont, false);
+    return nodes;
+}
+
+int main(int argc, char **argv) {
+    size_t max_churn = 10000 * bench_scale(argc, argv);
+    uint64_t values[BENCH_LIVE * 2];
+    for(size_t i = 0; i < BENCH_LIVE * 2; i++)
+        values[i] = i;
+    // The hazard pool may grow to hold the live entries and one scan's worth of retired ones, doubling slab by slab
+    size_t bound = 2 * (BENCH_LIVE + llist_hazard_threshold() + 1) + LLIST_POOL_MIN_SLAB;
+    for(size_t churn = max_churn / 100; churn <= max_churn; churn *= 10) {
+        size_t epoch = bench_churn(LLIST_RECLAIM_EPOCH, churn, values);
+        size_t hazard = bench_churn(LLIST_RECLAIM_HAZARD, churn, values);
+        // Nothing deleted can be reused while an epoch reader is stalled
+        BENCH_CHECK(epoch >= churn);
+        BENCH_CHECK(hazard <= bound);
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+//  bench_index.c
+//  LinkedListApp
+//
+//  Hash index lookups - hits and misses through llist_find on indexed containers of growing size, against walking
+//  the list for the smallest size.  Every hit is checked to come back with the right node.
+//
+
+#include "list.h"
+#include "bench.h"
+
+/* bench_walk looks up data by walking the list, the way lookups went before the index */
+static struct llist *bench_walk(struct llist_container *cont, const void *data, size_t d_size) {
+    for(struct llist *node = cont->head; node; node = node->next) {
+        if(node->data_size == d_size && !memcmp(node->data, data, d_size))
+            return node;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t scale = bench_scale(argc, argv);
+    size_t sizes[] = { 1000, 100 * scale, 10000 * scale };
+    size_t lookups = 10000 * scale;
+    uint64_t seed = 88172645463325252ULL;
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        char name[64];
+        uint64_t *keys = malloc(n * sizeof(uint64_t));
+        struct llist **nodes = malloc(n * sizeof(struct llist *));
+        struct llist_container *cont = container_new_indexed();
+        BENCH_CHECK(keys && nodes && cont);
+        for(size_t i = 0; i < n; i++) {
+            keys[i] = i * 2; // Odd keys are never inserted, so make misses
+            BENCH_CHECK(llist_add_tail_data(cont, &keys[i], sizeof(uint64_t)) == 0);
+            nodes[i] = cont->tail;
+        }
+        double start = bench_now();
+        for(size_t i = 0; i < lookups; i++) {
+            size_t k = bench_rand(&seed) % n;
+            BENCH_CHECK(llist_find(cont, &keys[k], sizeof(uint64_t)) == nodes[k]);
+        }
+        snprintf(name, sizeof(name), "index hit, %zu entries", n);
+        bench_report(name, lookups, bench_now() - start);
+        start = bench_now();
+        for(size_t i = 0; i < lookups; i++) {
+            uint64_t miss = (bench_rand(&seed) % n) * 2 + 1;
+            BENCH_CHECK(!llist_find(cont, &miss, sizeof(uint64_t)));
+        }
+        snprintf(name, sizeof(name), "index miss, %zu entries", n);
+        bench_report(name, lookups, bench_now() - start);
+        if(s == 0) {
+            start = bench_now();
+            for(size_t i = 0; i < lookups; i++) {
+                size_t k = bench_rand(&seed) % n;
+                BENCH_CHECK(bench_walk(cont, &keys[k], sizeof(uint64_t)) == nodes[k]);
+            }
+            snprintf(name, sizeof(name), "list walk hit, %zu entries", n);
+            bench_report(name, lookups, bench_now() - start);
+        }
+        container_free(cont, false);
+        free(nodes);
+        free(keys);
+    }
+    return 0;
+}
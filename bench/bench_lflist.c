@@ -0,0 +1,118 @@
+//
+//  bench_lflist.c
+//  LinkedListApp
+//
+//  Lock free list scaling - 1 to 32 threads running a mix of 60% finds, 20% adds and 20% deletes on the lock free
+//  list, and the same mix on an ordinary container behind its lock - not indexed, so both walk their list.  Each thread works its own slice of the keys and
+//  tracks which of them it has added, so every operation's result is checked, and the final contents are checked
+//  key by key.
+//
+
+#include <pthread.h>
+#include "list.h"
+#include "lflist.h"
+#include "bench.h"
+
+#define BENCH_MAX_THREADS 32
+#define BENCH_KEYS_PER_THREAD 64
+
+struct bench_lf_arg {
+    struct llist_lf_container *lf; // Set for the lock free run
+    struct llist_container *cont; // Set for the locked run
+    uint64_t *keys; // This thread's keys
+    bool *present; // Which of them are in the list
+    size_t ops;
+    uint64_t seed;
+};
+
+/* bench_lf_worker runs the operation mix on this thread's keys, checking each result against what it has added */
+static void *bench_lf_worker(void *p) {
+    struct bench_lf_arg *arg = p;
+    for(size_t i = 0; i < arg->ops; i++) {
+        uint64_t r = bench_rand(&arg->seed);
+        size_t k = r % BENCH_KEYS_PER_THREAD;
+        uint64_t *key = &arg->keys[k];
+        unsigned op = (r >> 32) % 10;
+        if(op < 6) {
+            bool found = arg->lf ? llist_lf_find(arg->lf, key, sizeof(uint64_t)) != NULL :
+                                   llist_find(arg->cont, key, sizeof(uint64_t)) != NULL;
+            BENCH_CHECK(found == arg->present[k]);
+        } else if(op < 8) {
+            if(arg->lf) {
+                BENCH_CHECK(llist_lf_add_data(arg->lf, key, sizeof(uint64_t)) == (arg->present[k] ? 1 : 0));
+            } else if(!arg->present[k]) {
+                BENCH_CHECK(llist_add_tail_data(arg->cont, key, sizeof(uint64_t)) == 0);
+            }
+            arg->present[k] = true;
+        } else {
+            int ret;
+            if(arg->lf) {
+                ret = llist_lf_delete_data(arg->lf, key, sizeof(uint64_t), false);
+            } else {
+                // Keys belong to one thread, so nobody else can delete the entry between the find and the delete
+                struct llist *node = llist_find(arg->cont, key, sizeof(uint64_t));
+                ret = node ? llist_delete_node(arg->cont, node, false) : -1;
+            }
+            BENCH_CHECK(ret == (arg->present[k] ? 0 : -1));
+            arg->present[k] = false;
+        }
+    }
+    return NULL;
+}
+
+/* bench_lf_run runs n_threads workers against either the lock free list or the locked container and checks what is
+ left in it.  Returns the time taken */
+static double bench_lf_run(bool lock_free, int n_threads, size_t ops, uint64_t *keys, bool *present) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    struct bench_lf_arg args[BENCH_MAX_THREADS];
+    struct llist_lf_container *lf = lock_free ? lf_container_new() : NULL;
+    struct llist_container *cont = lock_free ? NULL : container_new();
+    BENCH_CHECK(lf || cont);
+    memset(present, 0, BENCH_MAX_THREADS * BENCH_KEYS_PER_THREAD * sizeof(bool));
+    double start = bench_now();
+    for(int i = 0; i < n_threads; i++) {
+        args[i] = (struct bench_lf_arg){ .lf = lf, .cont = cont, .keys = keys + i * BENCH_KEYS_PER_THREAD,
+                                          .present = present + i * BENCH_KEYS_PER_THREAD, .ops = ops,
+                                          .seed = 0x9E3779B97F4A7C15ULL * (i + 1) };
+        BENCH_CHECK(pthread_create(&threads[i], NULL, bench_lf_worker, &args[i]) == 0);
+    }
+    for(int i = 0; i < n_threads; i++)
+        pthread_join(threads[i], NULL);
+    double secs = bench_now() - start;
+    size_t expect = 0;
+    for(size_t k = 0; k < (size_t)n_threads * BENCH_KEYS_PER_THREAD; k++) {
+        expect += present[k];
+        bool found = lf ? llist_lf_find(lf, &keys[k], sizeof(uint64_t)) != NULL :
+                          llist_find(cont, &keys[k], sizeof(uint64_t)) != NULL;
+        BENCH_CHECK(found == present[k]);
+    }
+    if(lf) {
+        BENCH_CHECK(atomic_load(&lf->list_entries) == expect);
+        lf_container_free(lf, false);
+    } else {
+        BENCH_CHECK(cont->list_entries == expect);
+        container_free(cont, false);
+    }
+    return secs;
+}
+
+int main(int argc, char **argv) {
+    size_t ops = 200 * bench_scale(argc, argv);
+    uint64_t *keys = malloc(BENCH_MAX_THREADS * BENCH_KEYS_PER_THREAD * sizeof(uint64_t));
+    bool *present = malloc(BENCH_MAX_THREADS * BENCH_KEYS_PER_THREAD * sizeof(bool));
+    BENCH_CHECK(keys && present);
+    for(size_t k = 0; k < BENCH_MAX_THREADS * BENCH_KEYS_PER_THREAD; k++)
+        keys[k] = k;
+    for(int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+        char name[64];
+        double secs = bench_lf_run(true, n_threads, ops, keys, present);
+        snprintf(name, sizeof(name), "lock free list, %d threads", n_threads);
+        bench_report(name, ops * n_threads, secs);
+        secs = bench_lf_run(false, n_threads, ops, keys, present);
+        snprintf(name, sizeof(name), "locked container, %d threads", n_threads);
+        bench_report(name, ops * n_threads, secs);
+    }
+    free(present);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,67 @@
+//
+//  bench_lock.c
+//  LinkedListApp
+//
+//  Container locks - threads take the container lock around a plain counter increment and around add and delete,
+//  for each lock type.  The counter checks the lock really excludes, and the list has to come out intact.
+//
+
+#include <pthread.h>
+#include "list.h"
+#include "bench.h"
+
+#define BENCH_MAX_THREADS 8
+
+struct bench_lock_arg {
+    struct llist_container *cont;
+    size_t ops;
+    uint64_t *counter;
+    uint64_t value;
+};
+
+/* bench_lock_worker increments the shared counter under the lock, then churns its own entries in and out */
+static void *bench_lock_worker(void *p) {
+    struct bench_lock_arg *arg = p;
+    for(size_t i = 0; i < arg->ops; i++) {
+        LOCK(arg->cont);
+        (*arg->counter)++;
+        UNLOCK(arg->cont);
+    }
+    for(size_t i = 0; i < arg->ops; i++) {
+        BENCH_CHECK(llist_add_tail_data(arg->cont, &arg->value, sizeof(uint64_t)) == 0);
+        struct llist *node = llist_find(arg->cont, &arg->value, sizeof(uint64_t));
+        BENCH_CHECK(node);
+        BENCH_CHECK(llist_delete_node(arg->cont, node, false) == 0);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t ops = 2000 * bench_scale(argc, argv);
+    const char *names[] = { "spin", "adaptive", "rw" };
+    enum llist_lock_type types[] = { LLIST_LOCK_SPIN, LLIST_LOCK_ADAPTIVE, LLIST_LOCK_RW };
+    for(size_t t = 0; t < 3; t++) {
+        for(int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+            pthread_t threads[BENCH_MAX_THREADS];
+            struct bench_lock_arg args[BENCH_MAX_THREADS];
+            uint64_t counter = 0;
+            char name[64];
+            struct llist_container *cont = container_new_indexed();
+            BENCH_CHECK(cont && container_set_lock_type(cont, types[t]) == 0);
+            double start = bench_now();
+            for(int i = 0; i < n_threads; i++) {
+                args[i] = (struct bench_lock_arg){ .cont = cont, .ops = ops, .counter = &counter, .value = i };
+                BENCH_CHECK(pthread_create(&threads[i], NULL, bench_lock_worker, &args[i]) == 0);
+            }
+            for(int i = 0; i < n_threads; i++)
+                pthread_join(threads[i], NULL);
+            double secs = bench_now() - start;
+            BENCH_CHECK(counter == ops * n_threads);
+            BENCH_CHECK(cont->list_entries == 0 && !cont->head && !cont->tail);
+            snprintf(name, sizeof(name), "%s lock, %d threads (lock + add/find/delete)", names[t], n_threads);
+            bench_report(name, ops * n_threads * 2, secs);
+            container_free(cont, false);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+//  bench_mpmc.c
+//  LinkedListApp
+//
+//  Multi producer, multi consumer ring - producers push their own numbered values and consumers pop them, for a
+//  few producer and consumer counts.  Every value has to be popped exactly once, so the consumers' counts and sums
+//  have to add up to what was pushed, and each consumer has to see any one producer's values in the order pushed.
+//
+
+#include <pthread.h>
+#include "ring.h"
+#include "bench.h"
+
+#define BENCH_MPMC_CAPACITY 1024
+#define BENCH_MPMC_MAX_THREADS 4
+#define BENCH_MPMC_PRODUCER_SHIFT 48 // Values carry the producer that pushed them above this bit
+
+struct bench_mpmc_arg {
+    struct llist_mpmc_ring *ring;
+    size_t id;
+    size_t n; // Values to push, or to pop for a consumer
+    uint64_t sum;
+};
+
+/* bench_mpmc_producer pushes 1 to n, tagged with its id */
+static void *bench_mpmc_producer(void *p) {
+    struct bench_mpmc_arg *arg = p;
+    for(uint64_t i = 1; i <= arg->n; i++)
+        llist_mpmc_push(arg->ring, (void *)(uintptr_t)(((uint64_t)arg->id << BENCH_MPMC_PRODUCER_SHIFT) | i), 0);
+    return NULL;
+}
+
+/* bench_mpmc_consumer pops its share of the values, summing them and checking each producer's come out in order */
+static void *bench_mpmc_consumer(void *p) {
+    struct bench_mpmc_arg *arg = p;
+    uint64_t last[BENCH_MPMC_MAX_THREADS] = { 0 };
+    void *data;
+    for(size_t i = 0; i < arg->n; i++) {
+        llist_mpmc_pop(arg->ring, &data, NULL);
+        uint64_t value = (uintptr_t)data;
+        size_t producer = value >> BENCH_MPMC_PRODUCER_SHIFT;
+        value &= ((uint64_t)1 << BENCH_MPMC_PRODUCER_SHIFT) - 1;
+        BENCH_CHECK(producer < BENCH_MPMC_MAX_THREADS && value > last[producer]);
+        last[producer] = value;
+        arg->sum += value;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t n = 20000 * bench_scale(argc, argv);
+    for(int n_producers = 1; n_producers <= BENCH_MPMC_MAX_THREADS; n_producers *= 2) {
+        for(int n_consumers = 1; n_consumers <= BENCH_MPMC_MAX_THREADS; n_consumers *= 2) {
+            pthread_t producers[BENCH_MPMC_MAX_THREADS], consumers[BENCH_MPMC_MAX_THREADS];
+            struct bench_mpmc_arg p_args[BENCH_MPMC_MAX_THREADS], c_args[BENCH_MPMC_MAX_THREADS];
+            size_t total = n * n_producers;
+            uint64_t sum = 0;
+            char name[64];
+            struct llist_mpmc_ring *ring = mpmc_ring_new(BENCH_MPMC_CAPACITY);
+            BENCH_CHECK(ring);
+            double start = bench_now();
+            for(int i = 0; i < n_consumers; i++) {
+                // The first consumer takes whatever doesn't divide evenly
+                c_args[i] = (struct bench_mpmc_arg){ .ring = ring, .id = i,
+                                                     .n = total / n_consumers + (i == 0 ? total % n_consumers : 0) };
+                BENCH_CHECK(pthread_create(&consumers[i], NULL, bench_mpmc_consumer, &c_args[i]) == 0);
+            }
+            for(int i = 0; i < n_producers; i++) {
+                p_args[i] = (struct bench_mpmc_arg){ .ring = ring, .id = i, .n = n };
+                BENCH_CHECK(pthread_create(&producers[i], NULL, bench_mpmc_producer, &p_args[i]) == 0);
+            }
+            for(int i = 0; i < n_producers; i++)
+                pthread_join(producers[i], NULL);
+            for(int i = 0; i < n_consumers; i++) {
+                pthread_join(consumers[i], NULL);
+                sum += c_args[i].sum;
+            }
+            double secs = bench_now() - start;
+            BENCH_CHECK(sum == (uint64_t)n * (n + 1) / 2 * n_producers);
+            BENCH_CHECK(llist_mpmc_try_pop(ring, NULL, NULL) < 0);
+            snprintf(name, sizeof(name), "mpmc ring, %d producers, %d consumers", n_producers, n_consumers);
+            bench_report(name, total, secs);
+            mpmc_ring_free(ring, false);
+        }
+    }
+    return 0;
+}
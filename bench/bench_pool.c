@@ -0,0 +1,142 @@
+//
+//  bench_pool.c
+//  LinkedListApp
+//
+//  Node allocation - a container's slab pool against one calloc per node with llist_new.  Times building a list,
+//  walking it, churning through add and delete and tearing it down, reports how much resident memory each list
+//  took, and checks every list holds what was put in it.
+//
+
+#include <unistd.h>
+#include "list.h"
+#include "bench.h"
+
+/* bench_sum walks a list adding up the values its entries point at */
+static uint64_t bench_sum(struct llist *head) {
+    uint64_t sum = 0;
+    for(struct llist *node = head; node; node = node->next)
+        sum += *(uint64_t *)node->data;
+    return sum;
+}
+
+/* bench_rss_kb returns the resident set size of the process in KB from /proc/self/statm, or 0 if it can't be read */
+static size_t bench_rss_kb(void) {
+    size_t size = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if(!statm)
+        return 0;
+    if(fscanf(statm, "%zu %zu", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/* bench_report_rss prints the resident memory a list of n entries added, from rss_before */
+static void bench_report_rss(const char *name, size_t n, size_t rss_before) {
+    size_t rss = bench_rss_kb();
+    size_t grown = rss > rss_before ? rss - rss_before : 0;
+    printf("%-48s %10zu KB    %10.1f bytes/entry\n", name, grown, grown * 1024.0 / n);
+    fflush(stdout);
+}
+
+/* bench_build_calloc builds a list of n nodes with llist_new.  If noise isn't NULL another allocation is made after
+ every node, as a real program would have in between, so the nodes end up scattered over the heap */
+static struct llist *bench_build_calloc(uint64_t *values, size_t n, void **noise) {
+    struct llist *head = NULL, *tail = NULL;
+    for(size_t i = 0; i < n; i++) {
+        struct llist *node = llist_new(&values[i], sizeof(uint64_t));
+        BENCH_CHECK(node);
+        if(noise)
+            noise[i] = malloc(48);
+        node->prev = tail;
+        if(tail)
+            tail->next = node;
+        else
+            head = node;
+        tail = node;
+    }
+    return head;
+}
+
+/* bench_free_calloc frees a list built with bench_build_calloc one node at a time */
+static void bench_free_calloc(struct llist *head) {
+    while(head) {
+        struct llist *next = head->next;
+        free(head);
+        head = next;
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t n = 10000 * bench_scale(argc, argv);
+    uint64_t *values = malloc(n * sizeof(uint64_t));
+    void **noise = malloc(n * sizeof(void *));
+    BENCH_CHECK(values && noise);
+    uint64_t expect = 0;
+    for(size_t i = 0; i < n; i++)
+        expect += values[i] = i;
+
+    // Pooled - the container carves its nodes out of slabs
+    size_t rss = bench_rss_kb();
+    struct llist_container *cont = container_new();
+    BENCH_CHECK(cont);
+    double start = bench_now();
+    for(size_t i = 0; i < n; i++)
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+    bench_report("pool: build list", n, bench_now() - start);
+    bench_report_rss("pool: resident memory", n, rss);
+    start = bench_now();
+    BENCH_CHECK(bench_sum(cont->head) == expect);
+    bench_report("pool: walk list", n, bench_now() - start);
+    start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        BENCH_CHECK(llist_delete_node(cont, cont->head, false) == 0);
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+    }
+    bench_report("pool: delete + add", n, bench_now() - start);
+    BENCH_CHECK(cont->list_entries == n && bench_sum(cont->head) == expect);
+    start = bench_now();
+    container_free(cont, false);
+    bench_report("pool: teardown (container_free)", n, bench_now() - start);
+
+    // Unpooled - llist_new callocs every node, timed on its own so it does the same work as the pooled build
+    rss = bench_rss_kb();
+    start = bench_now();
+    struct llist *head = bench_build_calloc(values, n, NULL);
+    bench_report("calloc: build list", n, bench_now() - start);
+    bench_report_rss("calloc: resident memory", n, rss);
+    start = bench_now();
+    BENCH_CHECK(bench_sum(head) == expect);
+    bench_report("calloc: walk list", n, bench_now() - start);
+    start = bench_now();
+    struct llist *tail = head;
+    while(tail->next)
+        tail = tail->next;
+    for(size_t i = 0; i < n; i++) {
+        struct llist *old = head, *node = llist_new(&values[i], sizeof(uint64_t));
+        BENCH_CHECK(node);
+        head = head->next;
+        head->prev = NULL;
+        free(old);
+        node->prev = tail;
+        tail->next = node;
+        tail = node;
+    }
+    bench_report("calloc: delete + add", n, bench_now() - start);
+    BENCH_CHECK(bench_sum(head) == expect);
+    start = bench_now();
+    bench_free_calloc(head);
+    bench_report("calloc: teardown (free per node)", n, bench_now() - start);
+
+    // The same list built with other allocations in between, untimed, to see what a scattered walk costs
+    head = bench_build_calloc(values, n, noise);
+    start = bench_now();
+    BENCH_CHECK(bench_sum(head) == expect);
+    bench_report("calloc: walk list (with other allocations)", n, bench_now() - start);
+    bench_free_calloc(head);
+    for(size_t i = 0; i < n; i++)
+        free(noise[i]);
+    free(noise);
+    free(values);
+    return 0;
+}
@@ -0,0 +1,62 @@
+//
+//  bench_rebuild.c
+//  LinkedListApp
+//
+//  Index rebuild over 200 byte records.  With USE_HASH_CACHE every node carries the hash of its data, so
+//  hash_map_create only reads the nodes - without it every record is hashed again on every rebuild.  The Makefile
+//  builds this twice, as bench_rebuild with the cache and as bench_rebuild_nocache with -DLLIST_NO_HASH_CACHE, to
+//  compare the two.  The index has to hold every record, and every record has to be found through it.
+//
+
+#include "list.h"
+#include "bench.h"
+
+#define BENCH_RECORD_SIZE 200
+#define BENCH_REBUILDS 5
+
+/* struct bench_record is one fixed size record - the key is at the front, the rest is payload */
+struct bench_record {
+    uint64_t key;
+    char payload[BENCH_RECORD_SIZE - sizeof(uint64_t)];
+};
+
+int main(int argc, char **argv) {
+    size_t n = 1000 * bench_scale(argc, argv);
+    struct bench_record *records = calloc(n, sizeof(struct bench_record));
+    BENCH_CHECK(records);
+#ifdef USE_HASH_CACHE
+    const char *config = "hash cache";
+#else
+    const char *config = "no hash cache";
+#endif
+    char name[64];
+    struct llist_container *cont = container_new();
+    BENCH_CHECK(cont);
+    for(size_t i = 0; i < n; i++) {
+        records[i].key = i;
+        memset(records[i].payload, (int)(i & 0xFF), sizeof(records[i].payload));
+        BENCH_CHECK(llist_add_tail_data(cont, &records[i], sizeof(struct bench_record)) == 0);
+    }
+
+    double start = bench_now();
+    for(int r = 0; r < BENCH_REBUILDS; r++)
+        BENCH_CHECK(hash_map_create(cont));
+    snprintf(name, sizeof(name), "%s: rebuild index, 200 byte records", config);
+    bench_report(name, n * BENCH_REBUILDS, bench_now() - start);
+    size_t indexed = 0, pos = 0;
+    while(hash_map_next(cont->h_map, &pos))
+        indexed++;
+    BENCH_CHECK(indexed == n);
+
+    BENCH_CHECK(container_set_indexed(cont, true) == 0);
+    start = bench_now();
+    for(size_t i = 0; i < n; i++) {
+        struct llist *node = llist_find(cont, &records[i], sizeof(struct bench_record));
+        BENCH_CHECK(node && node->data == &records[i]);
+    }
+    snprintf(name, sizeof(name), "%s: find, 200 byte records", config);
+    bench_report(name, n, bench_now() - start);
+    container_free(cont, false);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,109 @@
+//
+//  bench_ring.c
+//  LinkedListApp
+//
+//  Array backed ring against the linked ring from container_new_ring - filling each from an array, then walking
+//  every entry.  The array ring is walked once with llist_ring_peek per entry and once with llist_ring_foreach,
+//  which takes the lock once and scans the slots in order.  Every walk has to see exactly the values the ring was
+//  filled with, including a foreach over a ring that has wrapped round.  Odd sized rings are created
+//  and freed too, since their slot arrays are the ones whose size isn't already a multiple of a cache line.
+//
+
+#include "list.h"
+#include "ring.h"
+#include "bench.h"
+
+#define BENCH_RING_ENTRIES 65536
+
+/* bench_ring_add is the llist_ring_foreach callback adding up the values the slots point at */
+static bool bench_ring_add(struct llist_ring_slot *slot, void *arg) {
+    *(uint64_t *)arg += *(uint64_t *)slot->data;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t rounds = 2 * bench_scale(argc, argv);
+    uint64_t *values = malloc(BENCH_RING_ENTRIES * sizeof(uint64_t));
+    uint64_t expect = 0, sum;
+    BENCH_CHECK(values);
+    for(size_t i = 0; i < BENCH_RING_ENTRIES; i++) {
+        values[i] = i * 7 + 1;
+        expect += values[i];
+    }
+
+    for(size_t capacity = 1; capacity <= 1024; capacity = capacity * 3 + 1) {
+        struct llist_ring *ring = ring_container_new(capacity);
+        struct llist_spsc_ring *spsc = spsc_ring_new(capacity);
+        struct llist_mpmc_ring *mpmc = mpmc_ring_new(capacity);
+        BENCH_CHECK(ring && spsc && mpmc);
+        BENCH_CHECK(((uintptr_t)ring->slots & (LLIST_CACHE_LINE - 1)) == 0);
+        BENCH_CHECK(((uintptr_t)mpmc->slots & (LLIST_CACHE_LINE - 1)) == 0);
+        ring_container_free(ring, false);
+        spsc_ring_free(spsc, false);
+        mpmc_ring_free(mpmc, false);
+    }
+
+    struct llist_container *linked = container_new_ring(BENCH_RING_ENTRIES);
+    BENCH_CHECK(linked);
+    double start = bench_now();
+    for(size_t r = 0; r < rounds; r++)
+        BENCH_CHECK(list_set_from_array(linked, values, sizeof(uint64_t), BENCH_RING_ENTRIES) == 0);
+    bench_report("linked ring: fill", BENCH_RING_ENTRIES * rounds, bench_now() - start);
+    start = bench_now();
+    for(size_t r = 0; r < rounds; r++) {
+        struct llist *node = linked->head;
+        sum = 0;
+        for(size_t i = 0; i < BENCH_RING_ENTRIES; i++, node = node->next)
+            sum += *(uint64_t *)node->data;
+        BENCH_CHECK(sum == expect && node == linked->head);
+    }
+    bench_report("linked ring: walk", BENCH_RING_ENTRIES * rounds, bench_now() - start);
+    container_free(linked, false);
+
+    for(int locked = 1; locked >= 0; locked--) {
+        struct llist_ring *ring = ring_container_new(BENCH_RING_ENTRIES);
+        char name[64];
+        void *data;
+        BENCH_CHECK(ring && ring_container_set_lock(ring, locked) == 0);
+        start = bench_now();
+        for(size_t r = 0; r < rounds; r++)
+            BENCH_CHECK(ring_set_from_array(ring, values, sizeof(uint64_t), BENCH_RING_ENTRIES) == 0);
+        snprintf(name, sizeof(name), "array ring%s: fill", locked ? "" : " (unlocked)");
+        bench_report(name, BENCH_RING_ENTRIES * rounds, bench_now() - start);
+        BENCH_CHECK(llist_ring_entries(ring) == BENCH_RING_ENTRIES);
+        start = bench_now();
+        for(size_t r = 0; r < rounds; r++) {
+            sum = 0;
+            for(size_t i = 0; i < BENCH_RING_ENTRIES; i++) {
+                BENCH_CHECK(llist_ring_peek(ring, i, &data, NULL) == 0);
+                sum += *(uint64_t *)data;
+            }
+            BENCH_CHECK(sum == expect);
+        }
+        snprintf(name, sizeof(name), "array ring%s: walk (peek)", locked ? "" : " (unlocked)");
+        bench_report(name, BENCH_RING_ENTRIES * rounds, bench_now() - start);
+        start = bench_now();
+        for(size_t r = 0; r < rounds; r++) {
+            sum = 0;
+            BENCH_CHECK(llist_ring_foreach(ring, bench_ring_add, &sum) == BENCH_RING_ENTRIES);
+            BENCH_CHECK(sum == expect);
+        }
+        snprintf(name, sizeof(name), "array ring%s: walk (foreach)", locked ? "" : " (unlocked)");
+        bench_report(name, BENCH_RING_ENTRIES * rounds, bench_now() - start);
+        ring_container_free(ring, false);
+    }
+    // A ring that has wrapped round - the oldest entries are at the end of the slot array, the newest at the front
+    struct llist_ring *ring = ring_container_new(BENCH_RING_ENTRIES);
+    BENCH_CHECK(ring);
+    for(size_t i = 0; i < BENCH_RING_ENTRIES / 2; i++)
+        BENCH_CHECK(llist_ring_push(ring, &values[0], sizeof(uint64_t)) == 0);
+    for(size_t i = 0; i < BENCH_RING_ENTRIES / 2; i++)
+        BENCH_CHECK(llist_ring_pop(ring, NULL, NULL) == 0);
+    for(size_t i = 0; i < BENCH_RING_ENTRIES; i++)
+        BENCH_CHECK(llist_ring_push(ring, &values[i], sizeof(uint64_t)) == 0);
+    sum = 0;
+    BENCH_CHECK(llist_ring_foreach(ring, bench_ring_add, &sum) == BENCH_RING_ENTRIES && sum == expect);
+    ring_container_free(ring, false);
+    free(values);
+    return 0;
+}
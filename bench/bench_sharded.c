@@ -0,0 +1,123 @@
+//
+//  bench_sharded.c
+//  LinkedListApp
+//
+//  Sharded container - threads add, find and delete their own keys in a sharded container and in a single indexed
+//  container.  Then every thread races to delete the same keys, which only works if each entry is deleted by
+//  exactly one of them - every delete has to succeed once per key and the container has to come out empty.
+//
+
+#include <pthread.h>
+#include "sharded.h"
+#include "bench.h"
+
+#define BENCH_MAX_THREADS 8
+
+struct bench_sharded_arg {
+    struct llist_sharded_container *sc; // Sharded container, or NULL to use cont
+    struct llist_container *cont;
+    uint64_t *keys;
+    size_t n_keys;
+    size_t rounds;
+    size_t deleted;
+};
+
+/* bench_sharded_churn adds, finds and deletes the thread's own keys */
+static void *bench_sharded_churn(void *p) {
+    struct bench_sharded_arg *arg = p;
+    for(size_t r = 0; r < arg->rounds; r++) {
+        for(size_t i = 0; i < arg->n_keys; i++) {
+            if(arg->sc)
+                BENCH_CHECK(llist_sharded_add_data(arg->sc, &arg->keys[i], sizeof(uint64_t)) == 0);
+            else
+                BENCH_CHECK(llist_add_tail_data(arg->cont, &arg->keys[i], sizeof(uint64_t)) == 0);
+        }
+        for(size_t i = 0; i < arg->n_keys; i++) {
+            if(arg->sc) {
+                BENCH_CHECK(llist_sharded_find(arg->sc, &arg->keys[i], sizeof(uint64_t)));
+                BENCH_CHECK(llist_sharded_delete_data(arg->sc, &arg->keys[i], sizeof(uint64_t), false) == 0);
+            } else {
+                BENCH_CHECK(llist_find(arg->cont, &arg->keys[i], sizeof(uint64_t)));
+                BENCH_CHECK(llist_delete_data(arg->cont, &arg->keys[i], sizeof(uint64_t), false) == 0);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* bench_sharded_race tries to delete every key, counting the deletes that succeeded */
+static void *bench_sharded_race(void *p) {
+    struct bench_sharded_arg *arg = p;
+    for(size_t i = 0; i < arg->n_keys; i++) {
+        if(llist_sharded_delete_data(arg->sc, &arg->keys[i], sizeof(uint64_t), false) == 0)
+            arg->deleted++;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t scale = bench_scale(argc, argv);
+    size_t n_keys = 1000, rounds = scale;
+    uint64_t *keys = malloc(n_keys * BENCH_MAX_THREADS * sizeof(uint64_t));
+    BENCH_CHECK(keys);
+    for(size_t i = 0; i < n_keys * BENCH_MAX_THREADS; i++)
+        keys[i] = i;
+
+    for(int sharded = 0; sharded < 2; sharded++) {
+        for(int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+            pthread_t threads[BENCH_MAX_THREADS];
+            struct bench_sharded_arg args[BENCH_MAX_THREADS];
+            char name[64];
+            struct llist_sharded_container *sc = sharded ? sharded_container_new(0) : NULL;
+            struct llist_container *cont = sharded ? NULL : container_new_indexed();
+            BENCH_CHECK(sc || cont);
+            double start = bench_now();
+            for(int i = 0; i < n_threads; i++) {
+                args[i] = (struct bench_sharded_arg){ .sc = sc, .cont = cont, .keys = keys + i * n_keys,
+                                                      .n_keys = n_keys, .rounds = rounds };
+                BENCH_CHECK(pthread_create(&threads[i], NULL, bench_sharded_churn, &args[i]) == 0);
+            }
+            for(int i = 0; i < n_threads; i++)
+                pthread_join(threads[i], NULL);
+            double secs = bench_now() - start;
+            snprintf(name, sizeof(name), "%s, %d threads (add/find/delete)", sharded ? "sharded" : "single",
+                     n_threads);
+            bench_report(name, n_keys * rounds * n_threads * 3, secs);
+            if(sharded) {
+                BENCH_CHECK(sharded_container_entries(sc) == 0);
+                sharded_container_free(sc, false);
+            } else {
+                BENCH_CHECK(cont->list_entries == 0 && !cont->head && !cont->tail);
+                container_free(cont, false);
+            }
+        }
+    }
+
+    // Every thread deletes the same keys - each key must be deleted exactly once between them
+    size_t n_race = n_keys * BENCH_MAX_THREADS;
+    for(size_t r = 0; r < rounds; r++) {
+        pthread_t threads[BENCH_MAX_THREADS];
+        struct bench_sharded_arg args[BENCH_MAX_THREADS];
+        size_t deleted = 0;
+        struct llist_sharded_container *sc = sharded_container_new(4);
+        BENCH_CHECK(sc);
+        for(size_t i = 0; i < n_race; i++)
+            BENCH_CHECK(llist_sharded_add_data(sc, &keys[i], sizeof(uint64_t)) == 0);
+        for(int i = 0; i < BENCH_MAX_THREADS; i++) {
+            args[i] = (struct bench_sharded_arg){ .sc = sc, .keys = keys, .n_keys = n_race };
+            BENCH_CHECK(pthread_create(&threads[i], NULL, bench_sharded_race, &args[i]) == 0);
+        }
+        for(int i = 0; i < BENCH_MAX_THREADS; i++) {
+            pthread_join(threads[i], NULL);
+            deleted += args[i].deleted;
+        }
+        BENCH_CHECK(deleted == n_race);
+        BENCH_CHECK(sharded_container_entries(sc) == 0);
+        for(size_t i = 0; i < sc->n_shards; i++)
+            BENCH_CHECK(!sc->shards[i]->head && !sc->shards[i]->tail);
+        sharded_container_free(sc, false);
+    }
+    printf("%-48s %10zu rounds ok\n", "same key deletes, 8 threads", rounds);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,106 @@
+//
+//  bench_spsc.c
+//  LinkedListApp
+//
+//  Single producer, single consumer ring - one thread pushes a running count through the ring and another pops it,
+//  one entry at a time and in batches, against the locked array ring doing the same job.  The consumer checks every
+//  entry arrives exactly once and in order.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include "ring.h"
+#include "bench.h"
+
+#define BENCH_SPSC_CAPACITY 1024
+#define BENCH_SPSC_BATCH 32
+
+enum bench_spsc_mode { BENCH_SPSC_SINGLE, BENCH_SPSC_BATCHED, BENCH_SPSC_LOCKED };
+
+struct bench_spsc_arg {
+    enum bench_spsc_mode mode;
+    struct llist_spsc_ring *spsc;
+    struct llist_ring *ring;
+    size_t n;
+};
+
+/* bench_spsc_producer pushes 1 to n through the ring as the data pointers, yielding whenever the ring is full */
+static void *bench_spsc_producer(void *p) {
+    struct bench_spsc_arg *arg = p;
+    void *batch[BENCH_SPSC_BATCH];
+    size_t sizes[BENCH_SPSC_BATCH] = { 0 };
+    for(uintptr_t next = 1; next <= arg->n;) {
+        if(arg->mode == BENCH_SPSC_BATCHED) {
+            size_t n = arg->n - next + 1 < BENCH_SPSC_BATCH ? arg->n - next + 1 : BENCH_SPSC_BATCH;
+            for(size_t i = 0; i < n; i++)
+                batch[i] = (void *)(next + i);
+            size_t pushed = llist_spsc_push_many(arg->spsc, batch, sizes, n);
+            next += pushed;
+            if(!pushed)
+                sched_yield();
+        } else if(arg->mode == BENCH_SPSC_SINGLE) {
+            if(llist_spsc_push(arg->spsc, (void *)next, 0) == 0)
+                next++;
+            else
+                sched_yield();
+        } else {
+            // The locked ring overwrites when full, so hold off while it is
+            if(llist_ring_entries(arg->ring) <= arg->ring->mask && llist_ring_push(arg->ring, (void *)next, 0) == 0)
+                next++;
+            else
+                sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* bench_spsc_consumer pops n entries, checking each is the one after the last */
+static void *bench_spsc_consumer(void *p) {
+    struct bench_spsc_arg *arg = p;
+    void *batch[BENCH_SPSC_BATCH];
+    uintptr_t expect = 1;
+    while(expect <= arg->n) {
+        size_t popped = 0;
+        if(arg->mode == BENCH_SPSC_BATCHED)
+            popped = llist_spsc_pop_many(arg->spsc, batch, NULL, BENCH_SPSC_BATCH);
+        else if(arg->mode == BENCH_SPSC_SINGLE)
+            popped = llist_spsc_pop(arg->spsc, &batch[0], NULL) == 0;
+        else
+            popped = llist_ring_pop(arg->ring, &batch[0], NULL) == 0;
+        for(size_t i = 0; i < popped; i++)
+            BENCH_CHECK((uintptr_t)batch[i] == expect++);
+        if(!popped)
+            sched_yield();
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t n = 100000 * bench_scale(argc, argv);
+    const char *names[] = { "spsc ring, single push/pop", "spsc ring, batches of 32", "locked array ring" };
+    for(int mode = BENCH_SPSC_SINGLE; mode <= BENCH_SPSC_LOCKED; mode++) {
+        pthread_t producer, consumer;
+        struct bench_spsc_arg arg = { .mode = mode, .n = n };
+        if(mode == BENCH_SPSC_LOCKED) {
+            arg.ring = ring_container_new(BENCH_SPSC_CAPACITY);
+            BENCH_CHECK(arg.ring && ring_container_set_lock(arg.ring, true) == 0);
+        } else {
+            arg.spsc = spsc_ring_new(BENCH_SPSC_CAPACITY);
+            BENCH_CHECK(arg.spsc);
+        }
+        double start = bench_now();
+        BENCH_CHECK(pthread_create(&consumer, NULL, bench_spsc_consumer, &arg) == 0);
+        BENCH_CHECK(pthread_create(&producer, NULL, bench_spsc_producer, &arg) == 0);
+        pthread_join(producer, NULL);
+        pthread_join(consumer, NULL);
+        bench_report(names[mode], n, bench_now() - start);
+        if(mode == BENCH_SPSC_LOCKED) {
+            BENCH_CHECK(llist_ring_entries(arg.ring) == 0);
+            ring_container_free(arg.ring, false);
+        } else {
+            BENCH_CHECK(llist_spsc_pop(arg.spsc, NULL, NULL) < 0);
+            spsc_ring_free(arg.spsc, false);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+//  bench_stripes.c
+//  LinkedListApp
+//
+//  Striped hash index - threads add distinct keys to one indexed container, so their index updates only contend
+//  when keys land in the same stripe.  Every key has to be findable afterwards and indexed exactly once.  Also
+//  reports what the index of an empty and a one entry container costs, since stripes get their tables lazily.
+//
+
+#include <pthread.h>
+#include "list.h"
+#include "bench.h"
+
+#define BENCH_MAX_THREADS 8
+
+struct bench_stripes_arg {
+    struct llist_container *cont;
+    uint64_t *keys;
+    size_t n_keys;
+};
+
+/* bench_map_bytes returns the memory held by a hash index and its tables */
+static size_t bench_map_bytes(struct llist_map *map) {
+    size_t bytes = sizeof(struct llist_map);
+    for(int i = 0; i < HASHMAP_STRIPES; i++) {
+        struct llist_map_table *tables[2] = { atomic_load(&map->stripes[i].cur), atomic_load(&map->stripes[i].old) };
+        for(int t = 0; t < 2; t++) {
+            if(tables[t])
+                bytes += sizeof(struct llist_map_table) + tables[t]->n_slots * (sizeof(struct llist_map_slot) + 1);
+        }
+    }
+    return bytes;
+}
+
+/* bench_stripes_worker adds its keys to the shared container */
+static void *bench_stripes_worker(void *p) {
+    struct bench_stripes_arg *arg = p;
+    for(size_t i = 0; i < arg->n_keys; i++)
+        BENCH_CHECK(llist_add_tail_data(arg->cont, &arg->keys[i], sizeof(uint64_t)) == 0);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    size_t n_keys = 1000 * bench_scale(argc, argv);
+    uint64_t *keys = malloc(n_keys * BENCH_MAX_THREADS * sizeof(uint64_t));
+    BENCH_CHECK(keys);
+    for(size_t i = 0; i < n_keys * BENCH_MAX_THREADS; i++)
+        keys[i] = i;
+
+    struct llist_container *cont = container_new_indexed();
+    BENCH_CHECK(cont && cont->h_map);
+    size_t empty = bench_map_bytes(cont->h_map);
+    BENCH_CHECK(llist_add_tail_data(cont, &keys[0], sizeof(uint64_t)) == 0);
+    size_t one = bench_map_bytes(cont->h_map);
+    // Only the stripe the entry landed in should have a table
+    BENCH_CHECK(one - empty == sizeof(struct llist_map_table) + HASHMAP_MIN_SIZE * (sizeof(struct llist_map_slot) + 1));
+    printf("%-48s %10zu bytes\n", "index of empty container", empty);
+    printf("%-48s %10zu bytes\n", "index of one entry container", one);
+    container_free(cont, false);
+
+    for(int n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads *= 2) {
+        pthread_t threads[BENCH_MAX_THREADS];
+        struct bench_stripes_arg args[BENCH_MAX_THREADS];
+        char name[64];
+        cont = container_new_indexed();
+        BENCH_CHECK(cont);
+        double start = bench_now();
+        for(int i = 0; i < n_threads; i++) {
+            args[i] = (struct bench_stripes_arg){ .cont = cont, .keys = keys + i * n_keys, .n_keys = n_keys };
+            BENCH_CHECK(pthread_create(&threads[i], NULL, bench_stripes_worker, &args[i]) == 0);
+        }
+        for(int i = 0; i < n_threads; i++)
+            pthread_join(threads[i], NULL);
+        double secs = bench_now() - start;
+        snprintf(name, sizeof(name), "indexed add, %d threads", n_threads);
+        bench_report(name, n_keys * n_threads, secs);
+        BENCH_CHECK(cont->list_entries == n_keys * n_threads);
+        size_t indexed = 0, pos = 0;
+        while(hash_map_next(cont->h_map, &pos))
+            indexed++;
+        BENCH_CHECK(indexed == n_keys * n_threads);
+        for(size_t i = 0; i < n_keys * n_threads; i++) {
+            struct llist *node = llist_find(cont, &keys[i], sizeof(uint64_t));
+            BENCH_CHECK(node && node->data == &keys[i]);
+        }
+        container_free(cont, false);
+    }
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+//  bench_unrolled.c
+//  LinkedListApp
+//
+//  Unrolled list against struct llist for fixed size records - building each from the tail, then scanning every
+//  record, for a few record sizes.  The llist is run twice, once pointing at records in an array as a caller
+//  usually would, and once with the records copied inline into the nodes.  Bytes per record counts the nodes and,
+//  for the pointing llist, the records they point at, leaving out the allocator's own overhead.  Every scan has to
+//  add up to the values that went in.
+//
+
+#include "list.h"
+#include "unrolled.h"
+#include "bench.h"
+
+#define BENCH_UNROLLED_MAX_RECORD 32
+
+/* struct bench_record is the largest record used - smaller ones are its leading bytes, value first */
+struct bench_record {
+    uint64_t value;
+    unsigned char payload[BENCH_UNROLLED_MAX_RECORD - sizeof(uint64_t)];
+};
+
+/* bench_unrolled_add is the llist_unrolled_foreach callback adding up record values */
+static bool bench_unrolled_add(void *record, void *arg) {
+    *(uint64_t *)arg += *(uint64_t *)record;
+    return true;
+}
+
+/* bench_llist_add is the llist_foreach callback adding up record values */
+static bool bench_llist_add(struct llist *node, void *arg) {
+    *(uint64_t *)arg += *(uint64_t *)node->data;
+    return true;
+}
+
+/* bench_report_bytes prints bytes per record */
+static void bench_report_bytes(const char *name, size_t bytes, size_t n) {
+    printf("%-48s %10.1f bytes/record\n", name, (double)bytes / n);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    size_t n = 10000 * bench_scale(argc, argv), rounds = 20;
+    size_t record_sizes[] = { 8, 16, BENCH_UNROLLED_MAX_RECORD };
+    struct bench_record *records = calloc(n, sizeof(struct bench_record));
+    uint64_t expect = 0, sum;
+    BENCH_CHECK(records);
+    for(size_t i = 0; i < n; i++) {
+        records[i].value = i * 7 + 1;
+        expect += records[i].value;
+    }
+
+    for(size_t s = 0; s < sizeof(record_sizes) / sizeof(record_sizes[0]); s++) {
+        size_t r_size = record_sizes[s], nodes = 0;
+        char name[64];
+
+        struct llist_unrolled_container *unrolled = unrolled_container_new(r_size, 0);
+        BENCH_CHECK(unrolled);
+        double start = bench_now();
+        for(size_t i = 0; i < n; i++)
+            BENCH_CHECK(llist_unrolled_add_tail(unrolled, &records[i]) == 0);
+        snprintf(name, sizeof(name), "unrolled, %zu byte records: build", r_size);
+        bench_report(name, n, bench_now() - start);
+        start = bench_now();
+        for(size_t r = 0; r < rounds; r++) {
+            sum = 0;
+            BENCH_CHECK(llist_unrolled_foreach(unrolled, bench_unrolled_add, &sum) == (long)n && sum == expect);
+        }
+        snprintf(name, sizeof(name), "unrolled, %zu byte records: scan", r_size);
+        bench_report(name, n * rounds, bench_now() - start);
+        for(struct llist_unrolled_node *node = unrolled->head; node; node = node->next)
+            nodes++;
+        snprintf(name, sizeof(name), "unrolled, %zu byte records: memory", r_size);
+        bench_report_bytes(name, nodes * unrolled->node_size, n);
+        unrolled_container_free(unrolled);
+
+        for(int copied = 0; copied <= 1; copied++) {
+            const char *how = copied ? "inline" : "pointing";
+            struct llist_container *cont = container_new();
+            BENCH_CHECK(cont);
+            if(copied)
+                BENCH_CHECK(container_set_inline_size(cont, r_size) == 0);
+            start = bench_now();
+            for(size_t i = 0; i < n; i++) {
+                if(copied) {
+                    BENCH_CHECK(llist_add_tail_data(cont, NULL, 0) == 0);
+                    BENCH_CHECK(llist_insert_data_copy(cont, cont->tail, &records[i], r_size) == 0);
+                } else {
+                    BENCH_CHECK(llist_add_tail_data(cont, &records[i], r_size) == 0);
+                }
+            }
+            snprintf(name, sizeof(name), "llist %s, %zu byte records: build", how, r_size);
+            bench_report(name, n, bench_now() - start);
+            start = bench_now();
+            for(size_t r = 0; r < rounds; r++) {
+                sum = 0;
+                BENCH_CHECK(llist_foreach(cont, bench_llist_add, &sum) == (int)n && sum == expect);
+            }
+            snprintf(name, sizeof(name), "llist %s, %zu byte records: scan", how, r_size);
+            bench_report(name, n * rounds, bench_now() - start);
+            snprintf(name, sizeof(name), "llist %s, %zu byte records: memory", how, r_size);
+            bench_report_bytes(name, n * (cont->pool.node_size + (copied ? 0 : r_size)), n);
+            container_free(cont, false);
+        }
+    }
+    free(records);
+    return 0;
+}
@@ -0,0 +1,187 @@
+//
+//  check_compact.c
+//  LinkedListApp
+//
+//  Correctness checks for the compact list - random adds at the head and tail, inserts after and deletes of random
+//  entries, deletes of the head and tail, and operations on stale and out of range indices, mirrored on an array of
+//  indices.  After every step the links have to walk the same entries in both directions, the free list has to hold
+//  exactly the deleted nodes, and every add has to reuse the last deleted node before touching a new one.  The list
+//  starts with no nodes at all so it grows through realloc several times along the way.
+//
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "compact.h"
+#include "bench.h"
+
+#define CHECK_OPS 40000
+#define CHECK_MAX_ENTRIES 1024
+
+/* struct check_model is the reference - the node index of every entry in order, and the deleted nodes in the order
+ they should be reused */
+struct check_model {
+    uint32_t order[CHECK_MAX_ENTRIES];
+    size_t n;
+    uint32_t freed[CHECK_MAX_ENTRIES];
+    size_t n_freed;
+    uint32_t n_nodes; // What the node array should have grown to
+};
+
+/* check_data is the data pointer stored in the entry with tag - never dereferenced */
+static void *check_data(uint64_t tag) {
+    return (void *)(uintptr_t)(tag * 16);
+}
+
+/* check_rejected checks deletes of and inserts after index are both refused.  The library prints a message for
+ every one, and this runs tens of thousands of times, so stdout is pointed at /dev/null meanwhile */
+static void check_rejected(struct llist_compact_container *cont, uint32_t index) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    BENCH_CHECK(saved >= 0 && null >= 0 && dup2(null, STDOUT_FILENO) >= 0);
+    int deleted = llist_compact_delete(cont, index, false);
+    uint32_t inserted = llist_compact_insert_after(cont, index, check_data(1), 1);
+    fflush(stdout);
+    BENCH_CHECK(dup2(saved, STDOUT_FILENO) >= 0);
+    close(saved);
+    close(null);
+    BENCH_CHECK(deleted == -1 && inserted == LLIST_COMPACT_NIL);
+}
+
+/* check_list checks the links match the model in both directions and the free list holds just the deleted nodes */
+static void check_list(struct llist_compact_container *cont, struct check_model *model) {
+    uint32_t index = cont->head, prev = LLIST_COMPACT_NIL;
+    BENCH_CHECK(cont->list_entries == model->n && cont->n_nodes == model->n_nodes);
+    BENCH_CHECK(cont->used == model->n + model->n_freed && cont->used <= cont->n_nodes);
+    for(size_t i = 0; i < model->n; i++) {
+        BENCH_CHECK(index == model->order[i]);
+        BENCH_CHECK(llist_compact_node(cont, index)->prev == prev);
+        prev = index;
+        index = llist_compact_node(cont, index)->next;
+    }
+    BENCH_CHECK(index == LLIST_COMPACT_NIL && cont->tail == prev);
+    // The free list is a stack, most recently deleted first
+    index = cont->free_list;
+    for(size_t i = model->n_freed; i > 0; i--) {
+        BENCH_CHECK(index == model->freed[i - 1]);
+        BENCH_CHECK(llist_compact_node(cont, index)->prev == LLIST_COMPACT_NIL);
+        BENCH_CHECK(!llist_compact_node(cont, index)->data);
+        index = llist_compact_node(cont, index)->next;
+    }
+    BENCH_CHECK(index == LLIST_COMPACT_NIL);
+}
+
+/* check_added checks a new entry landed in the node the model expects, and records it at position pos */
+static void check_added(struct llist_compact_container *cont, struct check_model *model, uint32_t index,
+                        size_t pos, uint64_t tag) {
+    uint32_t expect;
+    if(model->n_freed) {
+        expect = model->freed[--model->n_freed];
+    } else {
+        expect = cont->used - 1;
+        // A new node past the end of the array means the array had to double, or be allocated in the first place
+        if(expect == model->n_nodes)
+            model->n_nodes = model->n_nodes ? model->n_nodes * 2 : LLIST_COMPACT_MIN;
+    }
+    BENCH_CHECK(index == expect);
+    BENCH_CHECK(llist_compact_node(cont, index)->data == check_data(tag));
+    BENCH_CHECK(llist_compact_data_size(cont, index) == tag % 1000);
+    memmove(&model->order[pos + 1], &model->order[pos], (model->n - pos) * sizeof(uint32_t));
+    model->order[pos] = index;
+    model->n++;
+}
+
+/* check_deleted deletes the entry at position pos of the model */
+static void check_deleted(struct llist_compact_container *cont, struct check_model *model, size_t pos) {
+    uint32_t index = model->order[pos];
+    BENCH_CHECK(llist_compact_delete(cont, index, false) == 0);
+    model->n--;
+    memmove(&model->order[pos], &model->order[pos + 1], (model->n - pos) * sizeof(uint32_t));
+    model->freed[model->n_freed++] = index;
+    // Deleting it again has to be refused, for as long as it sits on the free list
+    check_rejected(cont, index);
+}
+
+/* check_op does one random operation on both the list and the model */
+static void check_op(struct llist_compact_container *cont, struct check_model *model, uint64_t *state,
+                     uint64_t tag, bool grow) {
+    unsigned int op = bench_rand(state) % 16;
+    bool full = model->n == CHECK_MAX_ENTRIES;
+    uint32_t index;
+    if(op < (grow ? 4u : 1u) && !full) {
+        index = llist_compact_add_head(cont, check_data(tag), tag % 1000);
+        check_added(cont, model, index, 0, tag);
+    } else if(op < (grow ? 8u : 2u) && !full) {
+        index = llist_compact_add_tail(cont, check_data(tag), tag % 1000);
+        check_added(cont, model, index, model->n, tag);
+    } else if(op < (grow ? 11u : 4u) && !full && model->n) {
+        size_t pos = bench_rand(state) % model->n;
+        index = llist_compact_insert_after(cont, model->order[pos], check_data(tag), tag % 1000);
+        check_added(cont, model, index, pos + 1, tag);
+    } else if(op < 12) {
+        if(model->n)
+            check_deleted(cont, model, bench_rand(state) % model->n);
+    } else if(op < 13) {
+        if(model->n)
+            check_deleted(cont, model, 0);
+    } else if(op < 14) {
+        if(model->n)
+            check_deleted(cont, model, model->n - 1);
+    } else {
+        // Indices that never referred to an entry - nothing past used, and not the NIL link itself
+        uint32_t bad[] = { cont->used, cont->n_nodes, cont->used + (uint32_t)(bench_rand(state) % 1000),
+                           LLIST_COMPACT_NIL };
+        for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+            check_rejected(cont, bad[i]);
+        // A stale index from the free list, if there is one
+        if(model->n_freed)
+            check_rejected(cont, model->freed[bench_rand(state) % model->n_freed]);
+    }
+}
+
+/* check_sum is the llist_compact_foreach callback adding up data sizes */
+static bool check_sum(void *data, size_t d_size, void *arg) {
+    (void)data;
+    *(uint64_t *)arg += d_size;
+    return true;
+}
+
+int main(void) {
+    static struct check_model model;
+    uint64_t state = 0x2545F4914F6CDD1DULL, sum = 0, expect = 0;
+    // Start with no nodes at all, so every doubling from LLIST_COMPACT_MIN up is a realloc of a live list
+    struct llist_compact_container *cont = compact_container_new(0);
+    BENCH_CHECK(cont && cont->n_nodes == 0 && cont->head == LLIST_COMPACT_NIL);
+    check_rejected(cont, 0);
+    for(uint64_t i = 0; i < CHECK_OPS; i++) {
+        // Alternate between growing the list towards the limit and shrinking it back down
+        check_op(cont, &model, &state, i + 1, (i / 2000) % 2 == 0);
+        check_list(cont, &model);
+    }
+    BENCH_CHECK(model.n_nodes >= CHECK_MAX_ENTRIES);
+    for(size_t i = 0; i < model.n; i++)
+        expect += llist_compact_data_size(cont, model.order[i]);
+    BENCH_CHECK(llist_compact_foreach(cont, check_sum, &sum) == (long)model.n && sum == expect);
+    // Empty it from both ends, then check it refills from the free list without growing
+    while(model.n) {
+        check_deleted(cont, &model, model.n % 2 ? 0 : model.n - 1);
+        check_list(cont, &model);
+    }
+    BENCH_CHECK(cont->head == LLIST_COMPACT_NIL && cont->tail == LLIST_COMPACT_NIL);
+    for(uint64_t i = 0; i < CHECK_MAX_ENTRIES; i++) {
+        uint32_t index = llist_compact_add_tail(cont, check_data(i + 1), (i + 1) % 1000);
+        check_added(cont, &model, index, model.n, i + 1);
+        check_list(cont, &model);
+    }
+    compact_container_free(cont, false);
+
+    // A list created with room for some entries grows from there
+    cont = compact_container_new(3);
+    BENCH_CHECK(cont && cont->n_nodes == 3);
+    for(uint64_t i = 0; i < 4; i++)
+        BENCH_CHECK(llist_compact_add_tail(cont, check_data(i + 1), 1) == i);
+    BENCH_CHECK(cont->n_nodes == 6 && cont->list_entries == 4);
+    compact_container_free(cont, false);
+    printf("check_compact passed\n");
+    return 0;
+}
@@ -0,0 +1,49 @@
+//
+//  check_inline.c
+//  LinkedListApp
+//
+//  Correctness checks for llist_insert_data_copy - payloads that fit a container's inline size are copied into the
+//  node and released with it, anything else is allocated and freed with the data.  Containers without inline room
+//  never copy into the node, not even an empty payload.  Meant to be run under ASan as well, which catches data
+//  freed that was never allocated.
+//
+
+#include "list.h"
+#include "epoch.h"
+#include "bench.h"
+
+#define CHECK_ENTRIES 256
+
+/* check_copies copies payloads of every size up to max_size into a container, checks where each one landed, then
+ deletes them all freeing their data */
+static void check_copies(size_t inline_size, size_t max_size) {
+    unsigned char payload[LLIST_INLINE_MAX * 2] = { 0 };
+    struct llist_container *cont = container_new();
+    BENCH_CHECK(cont);
+    if(inline_size)
+        BENCH_CHECK(container_set_inline_size(cont, inline_size) == 0);
+    for(size_t i = 0; i < CHECK_ENTRIES; i++) {
+        size_t d_size = i % (max_size + 1);
+        memset(payload, (int)i, sizeof(payload));
+        BENCH_CHECK(llist_add_tail_data(cont, NULL, 0) == 0);
+        BENCH_CHECK(llist_insert_data_copy(cont, cont->tail, payload, d_size) == 0);
+        struct llist *node = cont->tail;
+        bool inlined = node->data == llist_node_inline(node);
+        BENCH_CHECK(inlined == (cont->inline_size && d_size <= cont->inline_size));
+        BENCH_CHECK(node->data_size == d_size && !memcmp(node->data, payload, d_size));
+    }
+    while(cont->head)
+        BENCH_CHECK(llist_delete_node(cont, cont->head, true) == 0);
+    // Free everything the deletes retired now, so anything freed that shouldn't have been shows up here
+    for(int i = 0; i < 3; i++)
+        llist_epoch_collect();
+    container_free(cont, true);
+}
+
+int main(void) {
+    check_copies(0, 32);
+    check_copies(16, 32);
+    check_copies(LLIST_INLINE_MAX, LLIST_INLINE_MAX * 2);
+    printf("check_inline passed\n");
+    return 0;
+}
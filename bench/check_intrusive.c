@@ -0,0 +1,117 @@
+//
+//  check_intrusive.c
+//  LinkedListApp
+//
+//  Correctness checks for the intrusive list index - entries with and without keys are linked, rekeyed and deleted,
+//  and after each step the index has to hold exactly the keyed entries still linked, each findable by its key.
+//  Deleting or rekeying an entry that isn't linked has to be refused without touching the list, and the tables
+//  retired as the index grows have to be freed along the way rather than piling up.
+//
+
+#include "intrusive.h"
+#include "epoch.h"
+#include "bench.h"
+
+#define CHECK_ENTRIES 512
+#define CHECK_GROWTH_ENTRIES 100000
+
+/* struct check_item is a caller owned entry - key 0 means the entry has no key */
+struct check_item {
+    uint64_t key;
+    struct llist_link link;
+};
+
+static struct check_item items[CHECK_ENTRIES];
+
+/* check_item_key is the container key function */
+static const void *check_item_key(struct llist_link *link, size_t *k_size) {
+    struct check_item *item = llist_link_entry(link, struct check_item, link);
+    *k_size = sizeof(uint64_t);
+    return item->key ? &item->key : NULL;
+}
+
+/* check_index checks the index holds every linked entry with a key and nothing else */
+static void check_index(struct llist_intrusive_container *cont, const bool *linked) {
+    size_t keyed = 0, indexed = 0, pos = 0;
+    for(size_t i = 0; i < CHECK_ENTRIES; i++) {
+        if(!linked[i] || !items[i].key)
+            continue;
+        keyed++;
+        BENCH_CHECK(items[i].link.indexed);
+        BENCH_CHECK(llist_link_find(cont, &items[i].key, sizeof(uint64_t)) == &items[i].link);
+    }
+    while(hash_map_next(cont->h_map, &pos))
+        indexed++;
+    BENCH_CHECK(indexed == keyed);
+}
+
+int main(void) {
+    bool linked[CHECK_ENTRIES] = { false };
+    struct llist_intrusive_container *cont = intrusive_container_new(check_item_key);
+    BENCH_CHECK(cont);
+    // Every third entry has no key, and its hash is left as garbage
+    for(size_t i = 0; i < CHECK_ENTRIES; i++) {
+        items[i].key = i % 3 ? i + 1 : 0;
+        items[i].link.hash = 0x5A5A5A5A5A5A5A5AULL * (i + 1);
+        BENCH_CHECK(llist_link_add_tail(cont, &items[i].link) == 0);
+        BENCH_CHECK(items[i].link.indexed == (items[i].key != 0));
+        linked[i] = true;
+    }
+    check_index(cont, linked);
+    // Take the key away from some entries and give one to others
+    for(size_t i = 0; i < CHECK_ENTRIES; i += 4) {
+        items[i].key = items[i].key ? 0 : i + 1;
+        BENCH_CHECK(llist_link_rekey(cont, &items[i].link) == 0);
+    }
+    check_index(cont, linked);
+    for(size_t i = 0; i < CHECK_ENTRIES; i += 2) {
+        BENCH_CHECK(llist_link_delete(cont, &items[i].link) == 0);
+        BENCH_CHECK(!items[i].link.indexed);
+        linked[i] = false;
+    }
+    check_index(cont, linked);
+    BENCH_CHECK(cont->list_entries == CHECK_ENTRIES / 2);
+    // Deleting again, or rekeying, entries that are no longer linked - including the first, which was the head.
+    // Every refusal prints a message, so only a sample of them
+    struct llist_link *head = cont->head, *tail = cont->tail;
+    for(size_t i = 0; i < CHECK_ENTRIES; i += 64) {
+        BENCH_CHECK(llist_link_delete(cont, &items[i].link) == -1);
+        BENCH_CHECK(llist_link_rekey(cont, &items[i].link) == -1);
+        BENCH_CHECK(!items[i].link.indexed);
+    }
+    BENCH_CHECK(cont->head == head && cont->tail == tail && cont->list_entries == CHECK_ENTRIES / 2);
+    check_index(cont, linked);
+    // An entry linked into another list isn't one of this list's
+    struct llist_intrusive_container *other = intrusive_container_new(check_item_key);
+    BENCH_CHECK(other);
+    BENCH_CHECK(llist_link_add_tail(other, &items[0].link) == 0);
+    BENCH_CHECK(llist_link_delete(cont, &items[0].link) == -1);
+    BENCH_CHECK(llist_link_delete(other, &items[0].link) == 0 && other->list_entries == 0);
+    intrusive_container_free(other, NULL);
+    // Deleting every entry left, from both ends, still leaves the list empty rather than corrupted
+    while(cont->head) {
+        BENCH_CHECK(llist_link_delete(cont, cont->tail) == 0);
+        if(cont->head)
+            BENCH_CHECK(llist_link_delete(cont, cont->head) == 0);
+    }
+    BENCH_CHECK(!cont->tail && cont->list_entries == 0);
+    BENCH_CHECK(llist_link_delete(cont, &items[1].link) == -1);
+    intrusive_container_free(cont, NULL);
+
+    // Grow the index a long way from one thread - the tables each growth replaces are retired, and have to be freed
+    // as entries are linked rather than left until the thread next enters a critical section
+    struct check_item *many = calloc(CHECK_GROWTH_ENTRIES, sizeof(struct check_item));
+    cont = intrusive_container_new(check_item_key);
+    BENCH_CHECK(many && cont);
+    for(size_t i = 0; i < CHECK_GROWTH_ENTRIES; i++) {
+        many[i].key = i + 1;
+        BENCH_CHECK(llist_link_add_tail(cont, &many[i].link) == 0);
+        BENCH_CHECK(!llist_epoch_self || llist_epoch_self->n_retired <= LLIST_EPOCH_COLLECT);
+    }
+    for(size_t i = 0; i < CHECK_GROWTH_ENTRIES; i += 97)
+        BENCH_CHECK(llist_link_find(cont, &many[i].key, sizeof(uint64_t)) == &many[i].link);
+    intrusive_container_free(cont, NULL);
+    free(many);
+    printf("check_intrusive passed\n");
+    return 0;
+}
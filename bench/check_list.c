@@ -0,0 +1,127 @@
+//
+//  check_list.c
+//  LinkedListApp
+//
+//  Correctness checks for lookups on the ordinary containers - llist_find, llist_contains and llist_find_many on
+//  indexed and unindexed containers, including ones whose index was only ever built by a one off hash_map_create.
+//
+
+#include "list.h"
+#include "bench.h"
+
+#define CHECK_ENTRIES 2000
+
+static uint64_t values[CHECK_ENTRIES];
+
+/* check_all checks every value in the first n is found at the node holding it, and none of the rest are */
+static void check_all(struct llist_container *cont, size_t n) {
+    const void *data[CHECK_ENTRIES];
+    size_t d_sizes[CHECK_ENTRIES];
+    struct llist *found[CHECK_ENTRIES];
+    for(size_t i = 0; i < CHECK_ENTRIES; i++) {
+        struct llist *node = llist_find(cont, &values[i], sizeof(uint64_t));
+        BENCH_CHECK(i < n ? node && node->data == &values[i] : !node);
+        BENCH_CHECK(llist_contains(cont, &values[i], sizeof(uint64_t)) == (i < n));
+        data[i] = &values[i];
+        d_sizes[i] = sizeof(uint64_t);
+    }
+    // Hazard pointer containers refuse batches, since the results couldn't all be protected
+    if(cont->reclaim == LLIST_RECLAIM_HAZARD)
+        n = 0;
+    BENCH_CHECK(llist_find_many(cont, data, d_sizes, CHECK_ENTRIES, found) == n);
+    for(size_t i = 0; i < CHECK_ENTRIES; i++)
+        BENCH_CHECK(i < n ? found[i] && found[i]->data == &values[i] : !found[i]);
+}
+
+/* check_container fills a container half way, checks lookups, then adds the rest and checks again */
+static void check_container(struct llist_container *cont, bool snapshot) {
+    for(size_t i = 0; i < CHECK_ENTRIES / 2; i++)
+        BENCH_CHECK(llist_add_tail_data(cont, &values[i], sizeof(uint64_t)) == 0);
+    if(snapshot)
+        BENCH_CHECK(hash_map_create(cont));
+    check_all(cont, CHECK_ENTRIES / 2);
+    // Entries added after a one off hash_map_create must still be found
+    for(size_t i = CHECK_ENTRIES / 2; i < CHECK_ENTRIES; i++)
+        BENCH_CHECK(llist_add_head_data(cont, &values[i], sizeof(uint64_t)) == 0);
+    check_all(cont, CHECK_ENTRIES);
+}
+
+/* check_visit is an llist_foreach callback that visits every entry */
+static bool check_visit(struct llist *node, void *arg) {
+    (void)node;
+    (void)arg;
+    return true;
+}
+
+/* check_order checks the list holds exactly the values at the given indexes, in order, and that each is found */
+static void check_order(struct llist_container *cont, const size_t *order, size_t n) {
+    struct llist *node = cont->head, *prev = NULL;
+    BENCH_CHECK(cont->list_entries == n);
+    for(size_t i = 0; i < n; i++, prev = node, node = node->next) {
+        BENCH_CHECK(node && node->prev == prev && node->data == &values[order[i]]);
+        BENCH_CHECK(llist_find(cont, &values[order[i]], sizeof(uint64_t)) == node);
+    }
+    BENCH_CHECK(!node && cont->tail == prev);
+}
+
+/* check_add_current checks llist_add_current_data inserts in front of the current entry rather than replacing it */
+static void check_add_current(struct llist_container *cont) {
+    // Into an empty list, the new entry is the whole list
+    BENCH_CHECK(llist_add_current_data(cont, &values[1], sizeof(uint64_t)) == 0);
+    check_order(cont, (size_t[]){ 1 }, 1);
+    BENCH_CHECK(llist_add_tail_data(cont, &values[2], sizeof(uint64_t)) == 0);
+    BENCH_CHECK(llist_add_tail_data(cont, &values[3], sizeof(uint64_t)) == 0);
+    // In the middle of the list
+    cont->list = cont->head->next;
+    BENCH_CHECK(llist_add_current_data(cont, &values[4], sizeof(uint64_t)) == 0);
+    BENCH_CHECK(cont->list->data == &values[4]);
+    check_order(cont, (size_t[]){ 1, 4, 2, 3 }, 4);
+    // At the head
+    cont->list = cont->head;
+    BENCH_CHECK(llist_add_current_data(cont, &values[5], sizeof(uint64_t)) == 0);
+    check_order(cont, (size_t[]){ 5, 1, 4, 2, 3 }, 5);
+    // Deleting an entry found through the index has to leave its neighbours intact
+    BENCH_CHECK(llist_delete_node(cont, llist_find(cont, &values[2], sizeof(uint64_t)), false) == 0);
+    check_order(cont, (size_t[]){ 5, 1, 4, 3 }, 4);
+    BENCH_CHECK(!llist_find(cont, &values[2], sizeof(uint64_t)));
+    BENCH_CHECK(llist_foreach(cont, check_visit, NULL) == 4);
+}
+
+int main(void) {
+    for(size_t i = 0; i < CHECK_ENTRIES; i++)
+        values[i] = i * 7919;
+
+    struct llist_container *cont = container_new();
+    check_container(cont, false);
+    container_free(cont, false);
+
+    cont = container_new();
+    check_container(cont, true);
+    // Turning indexing on afterwards has to pick up everything the stale snapshot missed
+    BENCH_CHECK(container_set_indexed(cont, true) == 0);
+    check_all(cont, CHECK_ENTRIES);
+    BENCH_CHECK(container_set_indexed(cont, false) == 0);
+    BENCH_CHECK(llist_delete_node(cont, cont->head, false) == 0);
+    BENCH_CHECK(container_set_indexed(cont, true) == 0);
+    check_all(cont, CHECK_ENTRIES - 1);
+    container_free(cont, false);
+
+    cont = container_new_indexed();
+    check_container(cont, false);
+    container_free(cont, false);
+
+    cont = container_new_indexed();
+    check_add_current(cont);
+    container_free(cont, false);
+    cont = container_new();
+    check_add_current(cont);
+    container_free(cont, false);
+
+    cont = container_new();
+    BENCH_CHECK(container_set_reclaim(cont, LLIST_RECLAIM_HAZARD) == 0);
+    BENCH_CHECK(container_set_indexed(cont, true) == 0);
+    check_container(cont, true);
+    container_free(cont, false);
+    printf("check_list passed\n");
+    return 0;
+}
@@ -0,0 +1,94 @@
+//
+//  check_rekey.c
+//  LinkedListApp
+//
+//  Stress check for changing an entry's data while lock free lookups run.  A writer keeps switching the tail of an
+//  indexed container between a short and a long buffer with llist_set_data while readers look both up through the
+//  index.  Every entry a reader gets back has to hold one of the two buffers at its own size - a data pointer paired
+//  with the other buffer's size would compare past the end of the short one, which an ASan build catches.
+//
+
+#include <pthread.h>
+#include "list.h"
+#include "bench.h"
+
+#define REKEY_READERS 3
+#define REKEY_SWITCHES 200000
+#define REKEY_LONG 4096
+
+static uint64_t short_key = 42;
+static unsigned char *long_key;
+static _Atomic(bool) done;
+
+/* check_entry checks an entry found by a lookup holds a whole buffer */
+static void check_entry(struct llist *node) {
+    void *data = node->data;
+    size_t d_size = node->data_size;
+    BENCH_CHECK((data == &short_key && d_size == sizeof(uint64_t)) || (data == long_key && d_size == REKEY_LONG));
+}
+
+/* rekey_reader looks both buffers up until the writer is done */
+static void *rekey_reader(void *p) {
+    struct llist_container *cont = p;
+    size_t hits = 0;
+    while(!atomic_load(&done)) {
+        BENCH_CHECK(llist_epoch_enter() == 0);
+        struct llist *node = llist_find(cont, &short_key, sizeof(uint64_t));
+        if(node) {
+            check_entry(node);
+            hits++;
+        }
+        if((node = llist_find(cont, long_key, REKEY_LONG))) {
+            check_entry(node);
+            hits++;
+        }
+        llist_epoch_exit();
+    }
+    return (void *)hits;
+}
+
+int main(void) {
+    pthread_t readers[REKEY_READERS];
+    uint64_t others[16];
+    long_key = calloc(1, REKEY_LONG);
+    // The long buffer starts with the same bytes as the short one, so a torn compare would look like a match
+    memcpy(long_key, &short_key, sizeof(uint64_t));
+    struct llist_container *cont = container_new_indexed();
+    BENCH_CHECK(long_key && cont);
+    for(size_t i = 0; i < 16; i++) {
+        others[i] = 1000 + i;
+        BENCH_CHECK(llist_add_tail_data(cont, &others[i], sizeof(uint64_t)) == 0);
+    }
+    BENCH_CHECK(llist_add_tail_data(cont, &short_key, sizeof(uint64_t)) == 0);
+    for(int i = 0; i < REKEY_READERS; i++)
+        BENCH_CHECK(pthread_create(&readers[i], NULL, rekey_reader, cont) == 0);
+    for(size_t i = 0; i < REKEY_SWITCHES; i++) {
+        bool to_long = i % 2 == 0;
+        BENCH_CHECK(llist_set_data(cont, to_long ? (void *)long_key : &short_key,
+                                   to_long ? REKEY_LONG : sizeof(uint64_t)) == 0);
+        // Only the data just set is findable once llist_set_data returns
+        struct llist *node = llist_find(cont, to_long ? (void *)long_key : &short_key,
+                                        to_long ? REKEY_LONG : sizeof(uint64_t));
+        BENCH_CHECK(node == cont->tail);
+        BENCH_CHECK(!llist_find(cont, to_long ? &short_key : (void *)long_key, to_long ? sizeof(uint64_t) : REKEY_LONG));
+    }
+    atomic_store(&done, true);
+    size_t hits = 0;
+    for(int i = 0; i < REKEY_READERS; i++) {
+        void *ret;
+        pthread_join(readers[i], &ret);
+        hits += (size_t)ret;
+    }
+    BENCH_CHECK(cont->list_entries == 17);
+    for(size_t i = 0; i < 16; i++)
+        BENCH_CHECK(llist_find(cont, &others[i], sizeof(uint64_t)) != NULL);
+    // list_set_from_array goes the same way
+    cont->list = cont->head;
+    BENCH_CHECK(list_set_from_array(cont, others, sizeof(uint64_t), 16) == 0);
+    for(size_t i = 0; i < 16; i++)
+        BENCH_CHECK(llist_find(cont, &others[i], sizeof(uint64_t)) != NULL);
+    printf("check_rekey passed, %zu reader hits during %d switches\n", hits, REKEY_SWITCHES);
+    container_free(cont, false);
+    free(long_key);
+    return 0;
+}
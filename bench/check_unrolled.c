@@ -0,0 +1,174 @@
+//
+//  check_unrolled.c
+//  LinkedListApp
+//
+//  Correctness checks for the unrolled list - random adds at the head, tail and current position, deletes of the
+//  current record and cursor moves, mirrored on a plain array.  After every step the nodes have to hold exactly the
+//  array's records in order, with no empty or overfull nodes, and the current position has to be on the same record
+//  as the array's.  Small nodes are used so splits and merges happen all the time, and the run fails if either
+//  never happened.
+//
+
+#include <string.h>
+#include "unrolled.h"
+#include "bench.h"
+
+#define CHECK_OPS 50000
+#define CHECK_MAX_RECORDS 2048
+
+/* struct check_record is a record with a check word after the value, so copies of the wrong size show */
+struct check_record {
+    uint64_t value;
+    uint64_t check;
+};
+
+/* struct check_model is the reference - the records in order, and the index of the current one or -1 if none */
+struct check_model {
+    struct check_record records[CHECK_MAX_RECORDS];
+    size_t n;
+    long cur;
+};
+
+static size_t splits, merges;
+
+/* check_record_make fills in a record from value */
+static struct check_record check_record_make(uint64_t value) {
+    return (struct check_record){ .value = value, .check = ~value * 0x9E3779B97F4A7C15ULL };
+}
+
+/* check_model_insert inserts record into the model at index pos */
+static void check_model_insert(struct check_model *model, size_t pos, const struct check_record *record) {
+    memmove(&model->records[pos + 1], &model->records[pos], (model->n - pos) * sizeof(struct check_record));
+    model->records[pos] = *record;
+    model->n++;
+}
+
+/* check_nodes returns the number of nodes in the list */
+static size_t check_nodes(struct llist_unrolled_container *cont) {
+    size_t nodes = 0;
+    for(struct llist_unrolled_node *node = cont->head; node; node = node->next)
+        nodes++;
+    return nodes;
+}
+
+/* check_list checks the nodes hold exactly the model's records and the current position matches the model's */
+static void check_list(struct llist_unrolled_container *cont, struct check_model *model) {
+    struct llist_unrolled_node *prev = NULL;
+    size_t index = 0;
+    long cur = -1;
+    BENCH_CHECK(cont->list_entries == model->n);
+    for(struct llist_unrolled_node *node = cont->head; node; prev = node, node = node->next) {
+        BENCH_CHECK(node->prev == prev);
+        BENCH_CHECK(node->count > 0 && node->count <= cont->node_capacity);
+        BENCH_CHECK(((uintptr_t)node & (LLIST_CACHE_LINE - 1)) == 0);
+        if(node == cont->list) {
+            BENCH_CHECK(cont->list_pos < node->count);
+            cur = (long)(index + cont->list_pos);
+        }
+        BENCH_CHECK(index + node->count <= model->n);
+        BENCH_CHECK(!memcmp(node->records, &model->records[index], node->count * sizeof(struct check_record)));
+        index += node->count;
+    }
+    BENCH_CHECK(cont->tail == prev && index == model->n);
+    // A current node that isn't in the list would leave cur at -1 here
+    BENCH_CHECK(cur == model->cur && (cont->list != NULL) == (model->cur >= 0));
+}
+
+/* check_op does one random operation on both the list and the model */
+static void check_op(struct llist_unrolled_container *cont, struct check_model *model, uint64_t *state,
+                     uint64_t *next_value, bool grow) {
+    struct check_record record = check_record_make((*next_value)++), got;
+    size_t nodes = check_nodes(cont);
+    // Adds outweigh deletes while growing and the other way round while shrinking
+    unsigned int op = bench_rand(state) % 16;
+    bool full = model->n == CHECK_MAX_RECORDS;
+    if(op < (grow ? 6u : 2u) && !full) {
+        BENCH_CHECK(llist_unrolled_add_current(cont, &record) == 0);
+        if(model->cur < 0)
+            model->cur = (long)model->n;
+        check_model_insert(model, (size_t)model->cur, &record);
+        // Inserting into the middle of a full node is the only way a node is split
+        if(check_nodes(cont) > nodes + (model->cur == (long)model->n - 1 ? 1 : 0))
+            splits++;
+    } else if(op < (grow ? 8u : 3u) && !full) {
+        BENCH_CHECK(llist_unrolled_add_head(cont, &record) == 0);
+        check_model_insert(model, 0, &record);
+        if(model->cur >= 0)
+            model->cur++;
+    } else if(op < (grow ? 10u : 4u) && !full) {
+        BENCH_CHECK(llist_unrolled_add_tail(cont, &record) == 0);
+        check_model_insert(model, model->n, &record);
+    } else if(op < 12) {
+        if(model->cur < 0) {
+            BENCH_CHECK(llist_unrolled_delete_current(cont) == -1);
+            return;
+        }
+        bool emptied = cont->list->count == 1;
+        BENCH_CHECK(llist_unrolled_delete_current(cont) == 0);
+        model->n--;
+        memmove(&model->records[model->cur], &model->records[model->cur + 1],
+                (model->n - (size_t)model->cur) * sizeof(struct check_record));
+        if(model->cur == (long)model->n)
+            model->cur = -1;
+        if(!emptied && check_nodes(cont) < nodes)
+            merges++;
+    } else if(op < 15) {
+        int ret = llist_unrolled_next(cont);
+        if(model->cur >= 0 && ++model->cur == (long)model->n)
+            model->cur = -1;
+        BENCH_CHECK(ret == (model->cur >= 0 ? 0 : -1));
+    } else {
+        // Rewind to somewhere random rather than always the head, so deletes land all over the list
+        BENCH_CHECK(llist_unrolled_rewind(cont) == (model->n ? 0 : -1));
+        model->cur = model->n ? 0 : -1;
+        for(size_t skip = model->n ? bench_rand(state) % model->n : 0; skip; skip--) {
+            BENCH_CHECK(llist_unrolled_next(cont) == 0);
+            model->cur++;
+        }
+    }
+    if(model->cur >= 0) {
+        BENCH_CHECK(llist_unrolled_get_current(cont, &got) == 0);
+        BENCH_CHECK(!memcmp(&got, &model->records[model->cur], sizeof(got)));
+    } else {
+        BENCH_CHECK(llist_unrolled_get_current(cont, &got) == -1);
+    }
+}
+
+/* check_sum is the llist_unrolled_foreach callback adding up record values */
+static bool check_sum(void *record, void *arg) {
+    *(uint64_t *)arg += ((struct check_record *)record)->value;
+    return true;
+}
+
+int main(void) {
+    static struct check_model model;
+    uint64_t state = 0x9E3779B97F4A7C15ULL, next_value = 1, sum = 0, expect = 0;
+    // Records are 16 bytes, so nodes hold from 2 to 14 of them and splits and merges are constant
+    for(size_t lines = 1; lines <= LLIST_UNROLLED_MAX_LINES; lines++) {
+        struct llist_unrolled_container *cont = unrolled_container_new(sizeof(struct check_record), lines);
+        BENCH_CHECK(cont);
+        model.n = 0;
+        model.cur = -1;
+        BENCH_CHECK(llist_unrolled_delete_current(cont) == -1 && llist_unrolled_rewind(cont) == -1);
+        splits = merges = 0;
+        for(size_t i = 0; i < CHECK_OPS; i++) {
+            // Alternate between growing the list towards the limit and shrinking it back down to nothing
+            check_op(cont, &model, &state, &next_value, (i / 5000) % 2 == 0);
+            check_list(cont, &model);
+        }
+        // A node of two records is never below half full while it has any, so only bigger nodes merge
+        BENCH_CHECK(splits > 0 && (merges > 0 || cont->node_capacity < 4));
+        sum = expect = 0;
+        for(size_t i = 0; i < model.n; i++)
+            expect += model.records[i].value;
+        BENCH_CHECK(llist_unrolled_foreach(cont, check_sum, &sum) == (long)model.n && sum == expect);
+        printf("%zu line nodes of %zu records: %zu splits, %zu merges\n", lines, cont->node_capacity, splits,
+               merges);
+        unrolled_container_free(cont);
+    }
+    // Records too big for a node to hold two of are refused
+    BENCH_CHECK(!unrolled_container_new(LLIST_CACHE_LINE, 1));
+    BENCH_CHECK(!unrolled_container_new(8, LLIST_UNROLLED_MAX_LINES + 1));
+    printf("check_unrolled passed\n");
+    return 0;
+}